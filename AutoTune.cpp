@@ -0,0 +1,353 @@
+/*
+ * This file is part of the BSGS distribution (https://github.com/JeanLucPons/Kangaroo).
+ * Copyright (c) 2020 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Kangaroo.h"
+#include "Timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <thread>
+#ifndef WIN64
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Tuning cache, in the home directory
+#define TUNE_FILE ".kangaroo256.tune"
+
+// Benchmark duration per candidate (s)
+#define TUNE_DURATION 0.3
+
+// Candidate group sizes (CPU_GRP_SIZE)
+#define TUNE_MIN_GRP 256
+#define TUNE_MAX_GRP 8192
+
+// DP size during the benchmark (rare DP)
+#define TUNE_DP 24
+
+// Minimum gain to prefer a more expensive setting (bigger herd,
+// more threads, smaller DP)
+#define TUNE_GAIN 1.02
+
+// ----------------------------------------------------------------------------
+
+static string GetHostId() {
+
+  char name[256];
+  name[0] = 0;
+#ifdef WIN64
+  const char *n = getenv("COMPUTERNAME");
+  if(n) strncpy(name,n,sizeof(name) - 1);
+#else
+  gethostname(name,sizeof(name) - 1);
+#endif
+  name[sizeof(name) - 1] = 0;
+  for(char *p = name; *p; p++)
+    if(*p == ' ') *p = '_';
+  return (name[0] != 0) ? string(name) : string("localhost");
+
+}
+
+static string GetTuneFileName() {
+
+#ifdef WIN64
+  const char *home = getenv("USERPROFILE");
+#else
+  const char *home = getenv("HOME");
+#endif
+  if(home == NULL || home[0] == 0)
+    return string(TUNE_FILE);
+  return string(home) + "/" + TUNE_FILE;
+
+}
+
+double Kangaroo::GetPhysicalRAM() {
+
+  // In MB, 8GB if unknown
+#if !defined(WIN64) && defined(_SC_PHYS_PAGES)
+  long nbPage = sysconf(_SC_PHYS_PAGES);
+  long pageSize = sysconf(_SC_PAGESIZE);
+  if(nbPage > 0 && pageSize > 0)
+    return (double)nbPage * (double)pageSize / (1024.0 * 1024.0);
+#endif
+  return 8192.0;
+
+}
+
+// ----------------------------------------------------------------------------
+
+bool Kangaroo::LoadTune(int maxThread,bool narrow,int *grpSize,int *nbThread) {
+
+  // One line per host/engine/symmetry/thread limit/distance width:
+  // host engine sym maxThread narrow grpSize nbThread rate dpRate
+  FILE *f = fopen(GetTuneFileName().c_str(),"r");
+  if(f == NULL)
+    return false;
+
+  string host = GetHostId();
+  char line[512];
+  bool found = false;
+  while(!found && fgets(line,sizeof(line),f)) {
+    char h[256];
+    int e,s,m,n,g,t;
+    double r,dr;
+    if(sscanf(line,"%255s %d %d %d %d %d %d %lf %lf",h,&e,&s,&m,&n,&g,&t,&r,&dr) != 9)
+      continue;
+    if(host == h && e == cpuEngine && s == (int)symmetry && m == maxThread && n == (int)narrow &&
+       g > 0 && t > 0 && t <= maxThread && r > 0.0 && dr > 0.0) {
+      *grpSize = g;
+      *nbThread = t;
+      tuneRate = r;
+      tuneDPRate = dr;
+      found = true;
+    }
+  }
+
+  fclose(f);
+  return found;
+
+}
+
+// ----------------------------------------------------------------------------
+
+void Kangaroo::SaveTune(int maxThread,bool narrow,int grpSize,int nbThread) {
+
+  string fileName = GetTuneFileName();
+  string host = GetHostId();
+  vector<string> lines;
+  char line[512];
+
+  // Keep the other entries
+  FILE *f = fopen(fileName.c_str(),"r");
+  if(f) {
+    while(fgets(line,sizeof(line),f)) {
+      char h[256];
+      int e,s,m,n;
+      if(sscanf(line,"%255s %d %d %d %d",h,&e,&s,&m,&n) == 5 &&
+         host == h && e == cpuEngine && s == (int)symmetry && m == maxThread && n == (int)narrow)
+        continue;
+      lines.push_back(string(line));
+    }
+    fclose(f);
+  }
+
+  snprintf(line,sizeof(line),"%s %d %d %d %d %d %d %.0f %.0f\n",host.c_str(),cpuEngine,(int)symmetry,maxThread,
+           (int)narrow,grpSize,nbThread,tuneRate,tuneDPRate);
+  lines.push_back(string(line));
+
+  f = fopen(fileName.c_str(),"w");
+  if(f == NULL) {
+    ::printf("Autotune: cannot write %s: %s\n",fileName.c_str(),::strerror(errno));
+    return;
+  }
+  for(int i = 0; i < (int)lines.size(); i++)
+    fputs(lines[i].c_str(),f);
+  fclose(f);
+
+}
+
+// ----------------------------------------------------------------------------
+
+double Kangaroo::CPUHerdRate(int nbThread,double duration) {
+
+  // nbThread engines walking concurrently, placed as the workers
+  vector<double> rate(nbThread,0.0);
+  vector<std::thread> th;
+  CPUTopology *topo = affinity ? new CPUTopology() : NULL;
+
+  for(int i = 0; i < nbThread; i++) {
+    th.push_back(std::thread([this,topo,i,duration,&rate]() {
+      if(topo) CPUTopology::Pin(topo->GetCPU(i));
+      rate[i] = CPUEngineRate(cpuEngine,duration);
+    }));
+  }
+
+  double total = 0.0;
+  for(int i = 0; i < nbThread; i++) {
+    th[i].join();
+    total += rate[i];
+  }
+  delete topo;
+  return total;
+
+}
+
+// ----------------------------------------------------------------------------
+
+double Kangaroo::TableRate() {
+
+  // DP insertion rate of the flush thread (single consumer)
+  int nb = 1 << 16;
+  HashTable *table = new HashTable();
+  Int *x = new Int[nb];
+  Int *d = new Int[nb];
+  for(int i = 0; i < nb; i++) {
+    x[i].Rand(256);
+    d[i].Rand(128);
+  }
+
+  double t0 = Timer::get_tick();
+  for(int i = 0; i < nb; i++)
+    table->Add(&x[i],&d[i],i % 2);
+  double t1 = Timer::get_tick();
+
+  table->Reset();
+  delete table;
+  delete[] x;
+  delete[] d;
+  return (double)nb / (t1 - t0);
+
+}
+
+// ----------------------------------------------------------------------------
+
+void Kangaroo::AutoTune(int *nbThread) {
+
+  int maxThread = *nbThread;
+  if(maxThread <= 0)
+    return;
+
+  if(ramBudget <= 0.0)
+    ramBudget = GetPhysicalRAM() / 2.0;
+
+  // Range width, the client gets it from the server later (assume wide)
+  int rangeBit = 128;
+  if(!clientMode) {
+    Int w;
+    w.Set(&rangeEnd);
+    w.Sub(&rangeStart);
+    rangeBit = w.GetBitLength();
+  }
+  bool narrow = rangeBit < NARROW_RANGE_BIT;
+
+  int grpSize = CPU_GRP_SIZE;
+  int nbT = maxThread;
+  if(LoadTune(maxThread,narrow,&grpSize,&nbT)) {
+    CPU_GRP_SIZE = grpSize;
+    *nbThread = nbT;
+    ::printf("Autotune: %d thread(s), group size %d, %.2f MK/s (cached)\n",nbT,grpSize,tuneRate / 1000000.0);
+    return;
+  }
+
+  ::printf("Autotune: benchmarking %s engine, up to %d thread(s)\n",CPUEngine::GetName(cpuEngine),maxThread);
+
+  // Bench jump table and DP mask, overwritten by CreateJumpTable()/SetDP()
+  rangePower = rangeBit;
+  int jumpBit = symmetry ? rangeBit / 2 : rangeBit / 2 + 1;
+  if(jumpBit > 256) jumpBit = 256;
+  for(int i = 0; i < NB_JUMP; i++) {
+    jumpDistance[i].Rand(jumpBit);
+    if(jumpDistance[i].IsZero()) jumpDistance[i].SetInt32(1);
+    Point J = secp->ComputePublicKey(&jumpDistance[i]);
+    jumpPointx[i].Set(&J.x);
+    jumpPointy[i].Set(&J.y);
+  }
+  escapeDistance.Set(&jumpDistance[0]);
+  escapePointx.Set(&jumpPointx[0]);
+  escapePointy.Set(&jumpPointy[0]);
+  int256_t mask = dMask;
+  memset(&dMask,0,sizeof(dMask));
+  dMask.i64[0] = (1ULL << TUNE_DP) - 1;
+
+  // Group size, one thread. Smaller herds have less DP overhead,
+  // a larger one must be TUNE_GAIN faster.
+  double best = 0.0;
+  for(int g = TUNE_MIN_GRP; g <= TUNE_MAX_GRP; g *= 2) {
+    CPU_GRP_SIZE = g;
+    double r = CPUHerdRate(1,TUNE_DURATION);
+    ::printf("Autotune: group size %5d: %.2f MK/s\n",g,r / 1000000.0);
+    if(r > best * TUNE_GAIN) {
+      best = r;
+      grpSize = g;
+    }
+  }
+  CPU_GRP_SIZE = grpSize;
+
+  // Thread count, the smallest one within TUNE_GAIN of the best rate
+  vector<int> cand;
+  vector<double> rate;
+  for(int n = 1; n < maxThread; n *= 2)
+    cand.push_back(n);
+  cand.push_back(maxThread);
+  best = 0.0;
+  for(int i = 0; i < (int)cand.size(); i++) {
+    rate.push_back(CPUHerdRate(cand[i],TUNE_DURATION));
+    ::printf("Autotune: %3d thread(s): %.2f MK/s\n",cand[i],rate[i] / 1000000.0);
+    if(rate[i] > best) best = rate[i];
+  }
+  for(int i = (int)cand.size() - 1; i >= 0; i--) {
+    if(rate[i] * TUNE_GAIN >= best) {
+      nbT = cand[i];
+      tuneRate = rate[i];
+    }
+  }
+
+  tuneDPRate = TableRate();
+  dMask = mask;
+
+  CPU_GRP_SIZE = grpSize;
+  *nbThread = nbT;
+  ::printf("Autotune: %d thread(s), group size %d, %.2f MK/s, table %.2f MDP/s\n",nbT,grpSize,
+           tuneRate / 1000000.0,tuneDPRate / 1000000.0);
+  SaveTune(maxThread,narrow,grpSize,nbT);
+
+}
+
+// ----------------------------------------------------------------------------
+
+int Kangaroo::AutoTuneDP() {
+
+  // Expected time to solution for the measured walk and table insertion
+  // rates (the flush thread runs beside the walkers). Among the DP sizes
+  // fitting in the RAM budget, take the fastest one, or a larger one when
+  // it is less than TUNE_GAIN slower (smaller table and work file).
+  int maxDP = rangePower / 2;
+  int bestDP = -1;
+  double bestT = 0.0;
+  double bestRAM = 0.0;
+
+  for(int dp = maxDP; dp >= 0; dp--) {
+    double op;
+    double ram;
+    ComputeExpected((double)dp,&op,&ram);
+    if(ram > ramBudget)
+      continue;
+    double t = op / tuneRate;
+    if(gaudrySchost)
+      t *= 1.0 + GS_RESTART_COST / pow(2.0,(double)dp);
+    double tDP = op / pow(2.0,(double)dp) / tuneDPRate;
+    if(tDP > t) t = tDP;
+    if(bestDP < 0 || t * TUNE_GAIN < bestT) {
+      bestDP = dp;
+      bestT = t;
+      bestRAM = ram;
+    }
+  }
+
+  if(bestDP < 0) {
+    ::printf("Autotune: RAM budget %.0fMB too small, DP %d\n",ramBudget,maxDP);
+    return maxDP;
+  }
+
+  ::printf("Autotune: DP %d, expected time %s, RAM %.1fMB (budget %.0fMB)\n",bestDP,
+           GetTimeStr(bestT).c_str(),bestRAM,ramBudget);
+  return bestDP;
+
+}
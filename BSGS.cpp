@@ -0,0 +1,475 @@
+/*
+ * This file is part of the BSGS distribution (https://github.com/JeanLucPons/Kangaroo).
+ * Copyright (c) 2020 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Kangaroo.h"
+#include "BSGS.h"
+#include "HugePage.h"
+#include "Timer.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+// Candidates per lookup (tag matches)
+#define BSGS_MAX_MATCH 8
+
+// Table of the rate benchmark
+#define BSGS_BENCH_ENTRY (1 << 20)
+
+// ----------------------------------------------------------------------------
+
+uint64_t BSGSTable::GetSize(uint64_t nbEntry) {
+
+  uint64_t s = 1;
+  while(s * 3 < nbEntry * 4)
+    s <<= 1;
+  return s;
+
+}
+
+BSGSTable::BSGSTable(uint64_t nbEntry) {
+
+  size = GetSize(nbEntry);
+  mask = size - 1;
+  // Zeroed, all slots empty
+  table = (std::atomic<uint64_t> *)HugePage::Alloc(size * sizeof(uint64_t));
+
+}
+
+BSGSTable::~BSGSTable() {
+  HugePage::Free(table,size * sizeof(uint64_t));
+}
+
+void BSGSTable::Insert(uint64_t *x,uint32_t j) {
+
+  uint64_t e = (x[1] & 0xFFFFFFFF00000000ULL) | (uint64_t)j;
+  uint64_t h = x[0] & mask;
+  uint64_t z = 0;
+  while(!table[h].compare_exchange_strong(z,e,std::memory_order_relaxed)) {
+    h = (h + 1) & mask;
+    z = 0;
+  }
+
+}
+
+int BSGSTable::Find(uint64_t *x,uint32_t *j,int maxJ) {
+
+  uint64_t tag = x[1] & 0xFFFFFFFF00000000ULL;
+  uint64_t h = x[0] & mask;
+  uint64_t e;
+  int nb = 0;
+  while((e = table[h].load(std::memory_order_relaxed)) != 0) {
+    if((e & 0xFFFFFFFF00000000ULL) == tag && nb < maxJ)
+      j[nb++] = (uint32_t)e;
+    h = (h + 1) & mask;
+  }
+  return nb;
+
+}
+
+// ----------------------------------------------------------------------------
+
+// P[i] += D for a batch, one shared inversion. Lanes with P[i].x == D.x
+// (P = +/-D) are left unchanged and returned in bad.
+static void AddBatch(int nb,Fe *px,Fe *py,Fe *dx,IntGroup *grp,Fe *dX,Fe *dY,vector<int> &bad) {
+
+  Fe dy;
+  Fe _s;
+  Fe _p;
+  Fe rx;
+  Fe ry;
+
+  bad.clear();
+  for(int i = 0; i < nb; i++) {
+    dx[i].ModSubK1(dX,&px[i]);
+    if(dx[i].IsZero()) {
+      bad.push_back(i);
+      dx[i].SetInt32(1);
+    }
+  }
+  grp->Set(dx);
+  grp->ModInv();
+
+  for(int i = 0; i < nb; i++) {
+
+    if(bad.size() > 0 && std::find(bad.begin(),bad.end(),i) != bad.end())
+      continue;
+
+    dy.ModSubK1(dY,&py[i]);
+    _s.ModMulK1(&dy,&dx[i]);     // s = (D.y-P.y)*inverse(D.x-P.x)
+    _p.ModSquareK1(&_s);
+
+    rx.ModSubK1(&_p,&px[i]);
+    rx.ModSubK1(dX);             // rx = s^2 - P.x - D.x
+
+    ry.ModSubK1(&px[i],&rx);
+    ry.ModMulK1(&_s);
+    ry.ModSubK1(&py[i]);         // ry = s*(P.x-rx) - P.y
+
+    px[i].Set(&rx);
+    py[i].Set(&ry);
+
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
+bool Kangaroo::CheckBSGS(Int *c,Int *j,Point &Q) {
+
+  // P = Q - c.G = +/-j.G
+  for(int s = 0; s < 2; s++) {
+    Int k(c);
+    if(s == 0)
+      k.ModSubK1order(j);
+    else
+      k.ModAddK1order(j);
+    Point P = secp->ComputePublicKey(&k);
+    if(P.equals(Q)) {
+      k.ModAddK1order(&rangeStart);
+      LOCK(ghMutex);
+      if(!endOfSearch) {
+        Output(&k,'B',0);
+        endOfSearch = true;
+      }
+      UNLOCK(ghMutex);
+      return true;
+    }
+  }
+  return false;
+
+}
+
+// ----------------------------------------------------------------------------
+
+double Kangaroo::BSGSRate(double duration) {
+
+  // Giant steps of one thread, lookups in a table larger than the caches
+  int B = BSGS_GRP;
+  BSGSTable *table = new BSGSTable(BSGS_BENCH_ENTRY);
+  Fe *px = new Fe[B];
+  Fe *py = new Fe[B];
+  Fe *dx = new Fe[B];
+  IntGroup grp(B);
+  vector<int> bad;
+  uint32_t jc[BSGS_MAX_MATCH];
+
+  vector<Int> k(B);
+  for(int l = 0; l < B; l++)
+    k[l].Rand(256);
+  vector<Point> P = secp->ComputePublicKeys(k);
+  for(int l = 0; l < B; l++) {
+    px[l].Set(&P[l].x);
+    py[l].Set(&P[l].y);
+  }
+  Int dk;
+  dk.Rand(256);
+  Point D = secp->ComputePublicKey(&dk);
+  Fe dX;
+  Fe dY;
+  dX.Set(&D.x);
+  dY.Set(&D.y);
+
+  uint64_t count = 0;
+  int nbMatch = 0;
+  double t0 = Timer::get_tick();
+  double t1 = t0;
+  while(t1 - t0 < duration) {
+    for(int l = 0; l < B; l++)
+      nbMatch += table->Find(px[l].v,jc,BSGS_MAX_MATCH);
+    AddBatch(B,px,py,dx,&grp,&dX,&dY,bad);
+    count += B;
+    t1 = Timer::get_tick();
+  }
+  (void)nbMatch;
+
+  delete[] px;
+  delete[] py;
+  delete[] dx;
+  delete table;
+  return (double)count / (t1 - t0);
+
+}
+
+// ----------------------------------------------------------------------------
+
+bool Kangaroo::SelectBSGS(uint64_t *nbBaby) {
+
+  if(bsgsMode == BSGS_OFF)
+    return false;
+
+  bool eligible = !clientMode && nbGPUThread == 0 && inputFile.length() == 0 && nbLoadedWalk == 0 &&
+                  tameDBFile.length() == 0 && !gaudrySchost && method == 2 && rangePower <= BSGS_MAX_BIT;
+  if(bsgsMode == BSGS_ON && !eligible) {
+    ::printf("Error: -bsgs is CPU only, for ranges up to 2^%d, not with -i, -tdb, -gs, -method 4 or client mode\n",
+             BSGS_MAX_BIT);
+    ::exit(-1);
+  }
+  // Keep the walks resumable when a work file is asked
+  if(!eligible || (bsgsMode == BSGS_AUTO && workFile.length() > 0))
+    return false;
+  if(workFile.length() > 0)
+    ::printf("Warning: -bsgs, work file disabled\n");
+
+  // Baby steps m for L keys: m + L.W/(4m) steps on average, the fewest
+  // for m = sqrt(L.W)/2, within the RAM budget
+  double budget = (ramBudget > 0.0) ? ramBudget : GetPhysicalRAM() / 2.0;
+  double L = (double)keysToSearch.size();
+  double W = rangeWidth.ToDouble() + 1.0;
+  double m = floor(sqrt(L * W) / 2.0);
+  if(m > floor(W / 2.0) + 1.0) m = floor(W / 2.0) + 1.0;
+  if(m > 4294967295.0) m = 4294967295.0;
+  if(m < 1.0) m = 1.0;
+  uint64_t maxSize = 1;
+  while((double)(maxSize * 2 * sizeof(uint64_t)) <= budget * 1024.0 * 1024.0)
+    maxSize <<= 1;
+  if(BSGSTable::GetSize((uint64_t)m) > maxSize)
+    m = (double)(maxSize / 4 * 3);
+  *nbBaby = (uint64_t)m;
+
+  double tableMB = (double)(BSGSTable::GetSize(*nbBaby) * sizeof(uint64_t)) / (1024.0 * 1024.0);
+  double opB = m + L * W / (4.0 * m);
+  double opK = expectedNbOp * (multiKey ? 1.0 : L);
+
+  // Measured rates of both engines on the active workers
+  int nbThread = (nbCPUActive > 0) ? nbCPUActive : 1;
+  double rateB = BSGSRate(0.2) * (double)nbThread;
+  double rateK = (tuneRate > 0.0) ? tuneRate : CPUEngineRate(cpuEngine,0.2) * (double)nbThread;
+  double tB = opB / rateB;
+  double tK = opK / rateK;
+
+  ::printf("BSGS: 2^%.2f baby steps, table %.1fMB, expected time %s (kangaroo %s)\n",log2(m),tableMB,
+           GetTimeStr(tB).c_str(),GetTimeStr(tK).c_str());
+  return bsgsMode == BSGS_ON || tB < tK;
+
+}
+
+// ----------------------------------------------------------------------------
+
+void Kangaroo::SolveBSGS(uint64_t nbBaby) {
+
+  int nbThread = (nbCPUActive > 0) ? nbCPUActive : 1;
+  int B = BSGS_GRP;
+  uint64_t m = nbBaby;
+  uint64_t nbLane = (uint64_t)nbThread * (uint64_t)B;
+  CPUTopology *topo = affinity ? new CPUTopology() : NULL;
+  std::atomic<int> nbDone(0);
+
+  ::printf("Solver: baby-step giant-step, %d thread(s)\n",nbThread);
+
+  // Progress of a phase, until all the workers are done
+  auto wait = [&](const char *phase,double total) {
+    double t0 = Timer::get_tick();
+    double lastT = t0;
+    while(nbDone.load() < nbThread) {
+      Timer::SleepMillis(20);
+      double t1 = Timer::get_tick();
+      if(t1 - lastT >= 1.0) {
+        uint64_t count = getCPUCount();
+        ::printf("\r[%.2f MK/s][BSGS %s %.1f%%][%s]  ",(double)count / (t1 - t0) / 1000000.0,phase,
+                 100.0 * (double)count / total,GetTimeStr(t1 - t0).c_str());
+        lastT = t1;
+      }
+    }
+  };
+
+  // Baby steps j.G, j in [1,m]. Lane l of thread t starts at t.B+l+1,
+  // all the lanes move by nbLane.G at each step.
+  BSGSTable *table = new BSGSTable(m);
+  double t0 = Timer::get_tick();
+  memset(counters,0,sizeof(counters));
+
+  auto baby = [&](int t) {
+
+    if(topo) CPUTopology::Pin(topo->GetCPU(t));
+    Fe *px = new Fe[B];
+    Fe *py = new Fe[B];
+    Fe *dx = new Fe[B];
+    IntGroup grp(B);
+    vector<int> bad;
+
+    vector<Int> k(B);
+    for(int l = 0; l < B; l++) {
+      k[l].SetInt32(0);
+      k[l].bits64[0] = (uint64_t)t * B + l + 1;
+    }
+    vector<Point> P = secp->ComputePublicKeys(k);
+    for(int l = 0; l < B; l++) {
+      px[l].Set(&P[l].x);
+      py[l].Set(&P[l].y);
+    }
+    Int dk((uint64_t)nbLane);
+    Point D = secp->ComputePublicKey(&dk);
+    Fe dX;
+    Fe dY;
+    dX.Set(&D.x);
+    dY.Set(&D.y);
+
+    for(uint64_t j0 = (uint64_t)t * B + 1; j0 <= m; j0 += nbLane) {
+      for(int l = 0; l < B; l++) {
+        if(j0 + l <= m)
+          table->Insert(px[l].v,(uint32_t)(j0 + l));
+      }
+      counters[t].count += B;
+      AddBatch(B,px,py,dx,&grp,&dX,&dY,bad);
+      // P = D, j = nbLane, next one computed directly
+      for(int i = 0; i < (int)bad.size(); i++) {
+        Int nk((uint64_t)(j0 + bad[i] + nbLane));
+        Point N = secp->ComputePublicKey(&nk);
+        px[bad[i]].Set(&N.x);
+        py[bad[i]].Set(&N.y);
+      }
+    }
+
+    delete[] px;
+    delete[] py;
+    delete[] dx;
+    nbDone++;
+
+  };
+
+  vector<std::thread> th;
+  for(int t = 0; t < nbThread; t++)
+    th.push_back(std::thread(baby,t));
+  wait("baby",(double)m);
+  for(int t = 0; t < nbThread; t++)
+    th[t].join();
+  th.clear();
+
+  double t1 = Timer::get_tick();
+  ::printf("\rBSGS: 2^%.2f baby steps, table %.1fMB, %s                    \n",log2((double)m),
+           (double)table->GetMemory() / (1024.0 * 1024.0),GetTimeStr(t1 - t0).c_str());
+
+  for(keyIdx = 0; keyIdx < keysToSearch.size(); keyIdx++) {
+
+    // Range start of the key
+    InitSearchKey();
+    endOfSearch = false;
+
+    // Q = key - start.G, k in [0,W]
+    Point Q = keysToSearch[keyIdx];
+    if(!rangeStart.IsZero()) {
+      Point RS = secp->ComputePublicKey(&rangeStart);
+      if(RS.x.IsEqual(&Q.x)) {
+        if(RS.y.IsEqual(&Q.y)) {
+          Int pk(&rangeStart);
+          Output(&pk,'B',0);
+        } else {
+          ::printf("\nKey#%2d not found in the range\n",keyIdx);
+        }
+        continue;
+      }
+      RS.y.ModNeg();
+      Q = secp->AddDirect(Q,RS);
+    }
+
+    // Giant step i covers k in [2m.i,2m.i+2m]
+    Int nbG(&rangeWidth);
+    Int twoM((uint64_t)(2 * m));
+    nbG.Div(&twoM);
+    uint64_t nbGiant = nbG.bits64[0] + 1;
+    Int delta(&twoM);
+    delta.Mult((uint64_t)nbLane);
+
+    memset(counters,0,sizeof(counters));
+    nbDone = 0;
+
+    // Lane l of thread t at giant index i = t.B+l, c = m + 2m.i,
+    // P = Q - c.G, all the lanes move by -delta.G at each step
+    auto giant = [&](int t) {
+
+      if(topo) CPUTopology::Pin(topo->GetCPU(t));
+      Fe *px = new Fe[B];
+      Fe *py = new Fe[B];
+      Fe *dx = new Fe[B];
+      IntGroup grp(B);
+      vector<int> bad;
+      uint32_t jc[BSGS_MAX_MATCH];
+
+      vector<Int> c(B);
+      for(int l = 0; l < B; l++) {
+        c[l].SetInt32(0);
+        c[l].bits64[0] = (uint64_t)t * B + l;
+        c[l].Mult(&twoM);
+        c[l].Add((uint64_t)m);
+      }
+      vector<Point> C = secp->ComputePublicKeys(c);
+      Int zero((uint64_t)0);
+      for(int l = 0; l < B && !endOfSearch; l++) {
+        // Q = c.G
+        if(C[l].x.IsEqual(&Q.x))
+          CheckBSGS(&c[l],&zero,Q);
+        C[l].y.ModNeg();
+      }
+      if(!endOfSearch) {
+        vector<Point> Qv(B,Q);
+        vector<Point> P = secp->AddDirect(Qv,C);
+        for(int l = 0; l < B; l++) {
+          px[l].Set(&P[l].x);
+          py[l].Set(&P[l].y);
+        }
+      }
+      Point D = secp->ComputePublicKey(&delta);
+      D.y.ModNeg();
+      Fe dX;
+      Fe dY;
+      dX.Set(&D.x);
+      dY.Set(&D.y);
+
+      for(uint64_t i0 = (uint64_t)t * B; i0 < nbGiant && !endOfSearch; i0 += nbLane) {
+        for(int l = 0; l < B; l++) {
+          int nb = table->Find(px[l].v,jc,BSGS_MAX_MATCH);
+          for(int i = 0; i < nb; i++) {
+            Int j((uint64_t)jc[i]);
+            CheckBSGS(&c[l],&j,Q);
+          }
+        }
+        counters[t].count += B;
+        AddBatch(B,px,py,dx,&grp,&dX,&dY,bad);
+        // P = +/-delta.G, Q = (c +/- delta).G
+        for(int i = 0; i < (int)bad.size(); i++)
+          CheckBSGS(&c[bad[i]],&delta,Q);
+        for(int l = 0; l < B; l++)
+          c[l].Add(&delta);
+      }
+
+      delete[] px;
+      delete[] py;
+      delete[] dx;
+      nbDone++;
+
+    };
+
+    for(int t = 0; t < nbThread; t++)
+      th.push_back(std::thread(giant,t));
+    wait("giant",(double)nbGiant);
+    for(int t = 0; t < nbThread; t++)
+      th[t].join();
+    th.clear();
+
+    if(!endOfSearch)
+      ::printf("\nKey#%2d not found in the range\n",keyIdx);
+
+  }
+
+  delete table;
+  delete topo;
+
+}
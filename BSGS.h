@@ -0,0 +1,51 @@
+/*
+ * This file is part of the BSGS distribution (https://github.com/JeanLucPons/Kangaroo).
+ * Copyright (c) 2020 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BSGSH
+#define BSGSH
+
+#include <atomic>
+#include <stdint.h>
+
+// Baby step table (-bsgs), open addressing, 8 bytes per slot: 32 bits of x
+// as tag and the baby step index j (j.G has this x, 0 for an empty slot).
+// The slot comes from other bits of x, a tag match is a candidate that
+// the caller checks. Filled concurrently, then read only.
+class BSGSTable {
+
+public:
+
+  BSGSTable(uint64_t nbEntry);
+  ~BSGSTable();
+
+  // Slots (power of 2) for nbEntry at a load factor <= 3/4
+  static uint64_t GetSize(uint64_t nbEntry);
+
+  void Insert(uint64_t *x,uint32_t j);
+  int Find(uint64_t *x,uint32_t *j,int maxJ);
+
+  uint64_t GetMemory() { return size * sizeof(uint64_t); }
+
+private:
+
+  std::atomic<uint64_t> *table;
+  uint64_t size;
+  uint64_t mask;
+
+};
+
+#endif // BSGSH
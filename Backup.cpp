@@ -196,9 +196,14 @@ bool Kangaroo::LoadWork(string &fileName) {
 
   if(!clientMode) {
 
-    fRead = ReadHeader(fileName,NULL,HEADW);
+    uint32_t version;
+    fRead = ReadHeader(fileName,&version,HEADW);
     if(fRead == NULL)
       return false;
+    if(((version & WORK_SYM) != 0) != symmetry) {
+      symmetry = (version & WORK_SYM) != 0;
+      ::printf("LoadWork: %s was created with symmetry %s, using it\n",fileName.c_str(),symmetry ? "on" : "off");
+    }
 
     keysToSearch.clear();
     Point key;
@@ -267,7 +272,7 @@ void Kangaroo::FetchWalks(uint64_t nbWalk,Int *x,Int *y,Int *d) {
   if(n<(int64_t)nbWalk) {
     int64_t empty = nbWalk - n;
     // Fill empty kanagaroo
-    CreateHerd((int)empty,&(x[n]),&(y[n]),&(d[n]),TAME);
+    CreateHerds((uint64_t)empty,&(x[n]),&(y[n]),&(d[n]));
   }
 
 }
@@ -323,7 +328,7 @@ void Kangaroo::FetchWalks(uint64_t nbWalk,std::vector<int256_t>& kangs,Int* x,In
   if(avail < nbWalk) {
     int64_t empty = nbWalk - avail;
     // Fill empty kanagaroo
-    CreateHerd((int)empty,&(x[n]),&(y[n]),&(d[n]),TAME);
+    CreateHerds((uint64_t)empty,&(x[n]),&(y[n]),&(d[n]));
   }
 
 }
@@ -351,8 +356,16 @@ void Kangaroo::FectchKangaroos(TH_PARAM *threads) {
     uint64_t nbSaved = nbLoadedWalk;
     uint64_t created = 0;
 
-    // Fetch loaded walk
+    // Fetch loaded walk, parked slots (-ctl) only get the saved herds left
+    // beside the GPU ones
+    uint64_t gpuRW = totalRW - (uint64_t)nbCPUActive * CPU_GRP_SIZE;
     for(int i = 0; i < nbCPUThread; i++) {
+      if(i >= nbCPUActive) {
+        if((uint64_t)nbLoadedWalk < gpuRW + CPU_GRP_SIZE)
+          continue;
+        threads[i].nbKangaroo = CPU_GRP_SIZE;
+        totalRW += CPU_GRP_SIZE;
+      }
       threads[i].px = new Int[CPU_GRP_SIZE];
       threads[i].py = new Int[CPU_GRP_SIZE];
       threads[i].distance = new Int[CPU_GRP_SIZE];
@@ -409,7 +422,7 @@ bool Kangaroo::SaveHeader(string fileName,FILE* f,int type,uint64_t totalCount,d
 
   // Header
   uint32_t head = type;
-  uint32_t version = 0;
+  uint32_t version = symmetry ? WORK_SYM : 0;
   if(::fwrite(&head,sizeof(uint32_t),1,f) != 1) {
     ::printf("SaveHeader: Cannot write to %s\n",fileName.c_str());
     ::printf("%s\n",::strerror(errno));
@@ -509,7 +522,15 @@ void Kangaroo::SaveServerWork() {
 
   WaitForAsyncSave();
 
-  saveRequest = true;
+  // Local walkers (hybrid server) park on saveMutex with their kangaroos
+  if(nbCPUActive > 0) {
+    LOCK(saveMutex);
+    saveRequest = true;
+    while(!isWaiting(walkers) && isAlive(walkers) && !endOfSearch)
+      Timer::SleepMillis(10);
+  } else {
+    saveRequest = true;
+  }
 
   double t0 = Timer::get_tick();
 
@@ -522,20 +543,36 @@ void Kangaroo::SaveServerWork() {
     ::printf("\nSaveWork: Cannot open %s for writing\n",fileName.c_str());
     ::printf("%s\n",::strerror(errno));
     saveRequest = false;
+    if(nbCPUActive > 0) UNLOCK(saveMutex);
     return;
   }
 
+  LOCK(ghMutex);
+  if(nbCPUActive > 0)
+    FlushDP();
   SaveWork(fileName,f,HEADW,0,0);
+  if(splitWorkfile)
+    hashTable.Reset();
+  UNLOCK(ghMutex);
 
+  // Kangaroos of the local walkers (-ws)
   uint64_t totalWalk = 0;
+  if(saveKangaroo) {
+    for(int i = 0; i < nbCPUThread; i++)
+      totalWalk += walkers[i].nbKangaroo;
+  }
   ::fwrite(&totalWalk,sizeof(uint64_t),1,f);
+  for(int i = 0; totalWalk > 0 && i < nbCPUThread; i++) {
+    for(uint64_t n = 0; n < walkers[i].nbKangaroo; n++) {
+      ::fwrite(&walkers[i].px[n].bits64,32,1,f);
+      ::fwrite(&walkers[i].py[n].bits64,32,1,f);
+      ::fwrite(&walkers[i].distance[n].bits64,32,1,f);
+    }
+  }
 
   uint64_t size = FTell(f);
   fclose(f);
 
-  if(splitWorkfile)
-    hashTable.Reset();
-
   double t1 = Timer::get_tick();
 
   char *ctimeBuff;
@@ -544,6 +581,8 @@ void Kangaroo::SaveServerWork() {
   ::printf("done [%.1f MB] [%s] %s",(double)size / (1024.0*1024.0),GetTimeStr(t1 - t0).c_str(),ctimeBuff);
 
   saveRequest = false;
+  if(nbCPUActive > 0)
+    UNLOCK(saveMutex);
 
 }
 
@@ -756,6 +795,11 @@ void Kangaroo::SaveWork(uint64_t totalCount,double totalTime,TH_PARAM *threads,i
   payload->startTick = t0;
   payload->headType = clientMode ? HEADK : HEADW;
 
+  // Staged DP must be in the table before the snapshot
+  LOCK(ghMutex);
+  if(!clientMode)
+    FlushDP();
+
   payload->tableSnapshot.bucketSizes.resize(HASH_SIZE);
   payload->tableSnapshot.bucketMax.resize(HASH_SIZE);
   payload->tableSnapshot.bucketOffsets.resize(HASH_SIZE);
@@ -775,6 +819,7 @@ void Kangaroo::SaveWork(uint64_t totalCount,double totalTime,TH_PARAM *threads,i
     }
     entryOffset += hashTable.E[h].nbItem;
   }
+  UNLOCK(ghMutex);
 
   if(saveKangaroo || saveKangarooText || saveKangarooByServer) {
     payload->kangarooX.reserve(actualKangarooCount);
@@ -878,7 +923,7 @@ void Kangaroo::WorkInfo(std::string &fName) {
     hashTable.SeekNbItem(f1);
   }
 
-  ::printf("Version   : %d\n",version);
+  ::printf("Version   : %d%s\n",version,(version & WORK_SYM) ? " (symmetry)" : "");
   ::printf("DP bits   : %d\n",dp1);
   ::printf("Start     : %s\n",RS1.GetBase16().c_str());
   ::printf("Stop      : %s\n",RE1.GetBase16().c_str());
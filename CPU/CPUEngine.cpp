@@ -0,0 +1,609 @@
+/*
+* This file is part of the BTCCollider distribution (https://github.com/JeanLucPons/Kangaroo).
+* Copyright (c) 2020 Jean Luc PONS.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CPUEngine.h"
+#include "../HugePage.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+CPUEngine::CPUEngine(int nbKangaroo,int type,bool symmetry) {
+
+  if(type == CPU_ENGINE_AUTO || !IsSupported(type))
+    type = GetBestType();
+
+  this->type = type;
+  this->nbKangaroo = nbKangaroo;
+  dx = NULL;
+  grp = NULL;
+  grpLast = NULL;
+  x52 = NULL;
+  y52 = NULL;
+  subp52 = NULL;
+  dx52 = NULL;
+  dpFlag = NULL;
+  prof = NULL;
+  pTick = 0;
+  narrow = false;
+  memset(dpMask,0,sizeof(dpMask));
+
+  if(type == CPU_ENGINE_SCALAR) {
+
+    // x,y,d planes + dx and prefix products
+    tileSize = HerdState::GetTileSize(nbKangaroo,3 * 32 + 2 * sizeof(Fe),1);
+    herd = new HerdState(nbKangaroo);
+    dx = new Fe[tileSize];
+    grp = new IntGroup(tileSize);
+    int last = nbKangaroo % tileSize;
+    if(last) grpLast = new IntGroup(last);
+
+  } else {
+
+#ifdef WITH_IFMA
+    // Whole vectors only, x,y,dx,prefix products in radix 2^52 + d planes
+    this->nbKangaroo = (nbKangaroo / IFMA_LANE) * IFMA_LANE;
+    tileSize = HerdState::GetTileSize(this->nbKangaroo,4 * 40 + 32,IFMA_LANE);
+    herd = new HerdState(this->nbKangaroo,false);
+    size_t size = (size_t)this->nbKangaroo * 5 * sizeof(uint64_t);
+    x52 = (uint64_t *)HugePage::Alloc(size);
+    y52 = (uint64_t *)HugePage::Alloc(size);
+    subp52 = (uint64_t *)HugePage::Alloc(size);
+    dx52 = (uint64_t *)HugePage::Alloc(size);
+    dpFlag = new uint8_t[this->nbKangaroo / IFMA_LANE];
+    grp = new IntGroup(IFMA_LANE);
+#endif
+
+  }
+
+  this->symmetry = symmetry;
+  jMask = symmetry ? NB_JUMP / 2 - 1 : NB_JUMP - 1;
+  symClass = new uint64_t[this->nbKangaroo];
+  memset(symClass,0,this->nbKangaroo * sizeof(uint64_t));
+  cycleKey = NULL;
+  cycleMin = NULL;
+  cycleState = NULL;
+  stepCount = 0;
+  nbEscape = 0;
+  if(symmetry) {
+    cycleKey = new uint64_t[this->nbKangaroo];
+    cycleMin = new uint64_t[this->nbKangaroo];
+    cycleState = new uint8_t[this->nbKangaroo];
+    memset(cycleState,0,this->nbKangaroo);
+  }
+
+  dpBit = 0;
+  nbStep = 0;
+  nbStuck = 0;
+  lastDP = new uint64_t[this->nbKangaroo];
+  memset(lastDP,0,this->nbKangaroo * sizeof(uint64_t));
+  memset(dpHist,0,sizeof(dpHist));
+
+}
+
+// ----------------------------------------------------------------------------
+
+CPUEngine::~CPUEngine() {
+
+  delete herd;
+  delete[] dx;
+  size_t size = (size_t)nbKangaroo * 5 * sizeof(uint64_t);
+  HugePage::Free(x52,size);
+  HugePage::Free(y52,size);
+  HugePage::Free(subp52,size);
+  HugePage::Free(dx52,size);
+  delete[] dpFlag;
+  delete grp;
+  delete grpLast;
+  delete[] symClass;
+  delete[] cycleKey;
+  delete[] cycleMin;
+  delete[] cycleState;
+  delete[] lastDP;
+
+}
+
+// ----------------------------------------------------------------------------
+
+int CPUEngine::GetBestType() {
+
+  if(IsSupported(CPU_ENGINE_IFMA))
+    return CPU_ENGINE_IFMA;
+  return CPU_ENGINE_SCALAR;
+
+}
+
+bool CPUEngine::IsSupported(int type) {
+
+  switch(type) {
+  case CPU_ENGINE_SCALAR:
+    return true;
+#ifdef WITH_IFMA
+  case CPU_ENGINE_IFMA:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma");
+#endif
+  }
+  return false;
+
+}
+
+const char *CPUEngine::GetName(int type) {
+
+  switch(type) {
+  case CPU_ENGINE_SCALAR:
+    return "Scalar";
+  case CPU_ENGINE_IFMA:
+    return "AVX512-IFMA x8";
+  }
+  return "Unknown";
+
+}
+
+int CPUEngine::GetType() {
+  return type;
+}
+
+int CPUEngine::GetNbKangaroo() {
+  return nbKangaroo;
+}
+
+bool CPUEngine::IsNarrow() {
+  return narrow;
+}
+
+uint64_t CPUEngine::GetNbEscape() {
+  return nbEscape;
+}
+
+void CPUEngine::GetWalkStats(uint64_t *dpHist,uint64_t *stuck) {
+  memcpy(dpHist,this->dpHist,sizeof(this->dpHist));
+  *stuck = nbStuck;
+}
+
+double CPUEngine::GetExpectedDPL(int bucket,int dpBit) {
+
+  // Geometric inter-arrival, P(L >= n) = (1-2^-dpSize)^(n-1)
+  double m = ldexp(1.0,dpBit);
+  double lo = (bucket == 0) ? 1.0 : ceil(ldexp(m,bucket - 4));
+  double hi = ceil(ldexp(m,bucket - 3));
+  double q = log1p(-1.0 / m);
+  if(dpBit == 0)
+    return (bucket == 0) ? 0.0 : (bucket == 4) ? 1.0 : 0.0;
+  if(bucket == DPL_BUCKET - 1)
+    return exp(q * (lo - 1.0));
+  return exp(q * (lo - 1.0)) - exp(q * (hi - 1.0));
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUEngine::SetParams(Int *dpMask,Int *distance,Int *px,Int *py,int rangePower) {
+
+  dpBit = 0;
+  for(int i = 0; i < 4; i++) {
+    this->dpMask[i] = dpMask->bits64[i];
+    for(int j = 0; j < 64; j++)
+      dpBit += (int)((this->dpMask[i] >> j) & 1);
+  }
+
+  narrow = rangePower < NARROW_RANGE_BIT;
+  for(int i = 0; i < NB_JUMP; i++) {
+    jD[i].Set(&distance[i]);
+    jPx[i].Set(&px[i]);
+    jPy[i].Set(&py[i]);
+    jD64[i] = jD[i].bits64[0];
+    narrow = narrow && jD[i].bits64[1] == 0 && jD[i].bits64[2] == 0 && jD[i].bits64[3] == 0;
+  }
+
+#ifdef WITH_IFMA
+  if(type == CPU_ENGINE_IFMA) {
+    // Jump table and DP mask in radix 2^52, [limb][jump]
+    Int m;
+    m.SetInt32(0);
+    for(int i = 0; i < 4; i++) m.bits64[i] = this->dpMask[i];
+    uint64_t tmp[5 * IFMA_LANE];
+    To52(tmp,0,&m);
+    for(int l = 0; l < 5; l++) dpMask52[l] = tmp[l * IFMA_LANE];
+    for(int i = 0; i < NB_JUMP; i++) {
+      To52(tmp,0,&px[i]);
+      for(int l = 0; l < 5; l++) jPx52[l * NB_JUMP + i] = tmp[l * IFMA_LANE];
+      To52(tmp,0,&py[i]);
+      for(int l = 0; l < 5; l++) jPy52[l * NB_JUMP + i] = tmp[l * IFMA_LANE];
+    }
+  }
+#endif
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUEngine::SetEscape(Int *distance,Int *px,Int *py) {
+
+  escD.Set(distance);
+  escPx.Set(px);
+  escPy.Set(py);
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUEngine::SetKangaroos(Int *px,Int *py,Int *d) {
+
+  for(int i = 0; i < nbKangaroo; i++)
+    SetKangaroo(i,&px[i],&py[i],&d[i]);
+
+}
+
+void CPUEngine::SetKangaroos(std::vector<uint64_t> &kIdx,Int *px,Int *py,Int *d) {
+
+  for(int i = 0; i < (int)kIdx.size(); i++)
+    SetKangaroo(kIdx[i],&px[i],&py[i],&d[i]);
+
+}
+
+void CPUEngine::GetKangaroos(Int *px,Int *py,Int *d) {
+
+  for(int i = 0; i < nbKangaroo; i++) {
+    if(narrow) herd->FoldD(i);
+#ifdef WITH_IFMA
+    if(type == CPU_ENGINE_IFMA) {
+      GetIFMA(i,&px[i],&py[i]);
+    } else
+#endif
+    {
+      herd->GetX(i,&px[i]);
+      herd->GetY(i,&py[i]);
+    }
+    herd->GetD(i,&d[i]);
+  }
+
+}
+
+void CPUEngine::SetKangaroo(uint64_t kIdx,Int *px,Int *py,Int *d) {
+
+#ifdef WITH_IFMA
+  if(type == CPU_ENGINE_IFMA) {
+    SetIFMA(kIdx,px,py);
+  } else
+#endif
+  {
+    herd->SetX((int)kIdx,px);
+    herd->SetY((int)kIdx,py);
+  }
+  herd->SetD((int)kIdx,d);
+  herd->ClearAcc((int)kIdx);
+  symClass[kIdx] = 0;
+  if(symmetry) cycleState[kIdx] = 0;
+  lastDP[kIdx] = nbStep;
+
+}
+
+// ----------------------------------------------------------------------------
+
+bool CPUEngine::IsDP(int kIdx) {
+
+  return ((herd->x[3][kIdx] & dpMask[3]) == 0) &&
+         ((herd->x[2][kIdx] & dpMask[2]) == 0) &&
+         ((herd->x[1][kIdx] & dpMask[1]) == 0) &&
+         ((herd->x[0][kIdx] & dpMask[0]) == 0);
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUEngine::SetProfile(CPUProfile *prof) {
+  this->prof = prof;
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUEngine::Launch(std::vector<ITEM> &dpFound) {
+
+  dpFound.clear();
+  pTick = prof ? prof->Begin() : 0;
+
+#ifdef WITH_IFMA
+  if(type == CPU_ENGINE_IFMA) {
+    LaunchIFMA(dpFound);
+  } else
+#endif
+  LaunchScalar(dpFound);
+
+  if(symmetry)
+    CheckCycles(dpFound);
+
+  nbStep++;
+  UpdateWalkStats(dpFound);
+  PROF_MARK(PROF_DP);
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUEngine::UpdateWalkStats(std::vector<ITEM> &dpFound) {
+
+  // Length since the previous DP, in 1/8 of the expected mean
+  for(int i = 0; i < (int)dpFound.size(); i++) {
+    uint64_t k = dpFound[i].kIdx;
+    uint64_t q = ((nbStep - lastDP[k]) << 3) >> dpBit;
+    int b = 0;
+    while(b < DPL_BUCKET - 1 && (q >> b) != 0) b++;
+    dpHist[b]++;
+    lastDP[k] = nbStep;
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
+int CPUEngine::GetStuck(std::vector<uint64_t> &kIdx) {
+
+  // Kangaroo trapped in a cycle or merged with an undetected same herd
+  // partner, they burn steps without producing DP
+  if(nbStep % STUCK_PERIOD != 0 || dpBit + 5 >= 64)
+    return 0;
+
+  uint64_t maxLength = (uint64_t)STUCK_FACTOR << dpBit;
+  int nb = 0;
+  for(int k = 0; k < nbKangaroo; k++) {
+    if(nbStep - lastDP[k] > maxLength) {
+      kIdx.push_back(k);
+      lastDP[k] = nbStep;
+      nb++;
+    }
+  }
+  nbStuck += nb;
+  return nb;
+
+}
+
+// ----------------------------------------------------------------------------
+
+uint64_t CPUEngine::GetKey(int k) {
+
+  // Low limb of x (52 bits for IFMA) and symmetry class
+#ifdef WITH_IFMA
+  if(type == CPU_ENGINE_IFMA)
+    return x52[(k / IFMA_LANE) * 5 * IFMA_LANE + (k % IFMA_LANE)] ^ symClass[k];
+#endif
+  return herd->x[0][k] ^ symClass[k];
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUEngine::CheckCycles(std::vector<ITEM> &dpFound) {
+
+  // A kangaroo whose key comes back within CYCLE_WINDOW steps is trapped
+  // in a fruitless cycle. Once the whole cycle has been seen, it leaves
+  // from the point having the lowest key, so two walks trapped in the
+  // same cycle escape the same way and stay merged.
+  bool newWindow = (stepCount % CYCLE_WINDOW) == 0;
+  stepCount++;
+
+  for(int k = 0; k < nbKangaroo; k++) {
+
+    uint64_t key = GetKey(k);
+
+    if(cycleState[k]) {
+      // Escape pending
+      if(key == cycleMin[k]) {
+        Escape(k,dpFound);
+        cycleState[k] = 0;
+        cycleKey[k] = cycleMin[k] = GetKey(k);
+      }
+      continue;
+    }
+
+    if(newWindow) {
+      cycleKey[k] = key;
+      cycleMin[k] = key;
+    } else if(key == cycleKey[k]) {
+      // Back to the window start, cycleMin is the cycle minimum
+      if(key == cycleMin[k]) {
+        Escape(k,dpFound);
+        cycleKey[k] = cycleMin[k] = GetKey(k);
+      } else {
+        cycleState[k] = 1;
+      }
+    } else if(key < cycleMin[k]) {
+      cycleMin[k] = key;
+    }
+
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUEngine::Escape(int k,std::vector<ITEM> &dpFound) {
+
+  Int px;
+  Int py;
+  Int d;
+  Int dx;
+  Int dy;
+  Int rx;
+  Int ry;
+  Int _s;
+  Int _p;
+
+#ifdef WITH_IFMA
+  if(type == CPU_ENGINE_IFMA) {
+    GetIFMA(k,&px,&py);
+  } else
+#endif
+  {
+    herd->GetX(k,&px);
+    herd->GetY(k,&py);
+  }
+  if(narrow) herd->FoldD(k);
+  herd->GetD(k,&d);
+
+  // P + E
+  dx.ModSub(&px,&escPx);
+  dx.ModInv();
+  dy.ModSub(&py,&escPy);
+  _s.ModMulK1(&dy,&dx);
+  _p.ModSquareK1(&_s);
+
+  rx.ModSub(&_p,&escPx);
+  rx.ModSub(&px);
+
+  ry.ModSub(&px,&rx);
+  ry.ModMulK1(&_s);
+  ry.ModSub(&py);
+
+  d.ModAddK1order(&escD);
+  if(ry.ModPositiveK1()) {
+    d.ModNegK1order();
+    symClass[k] = !symClass[k];
+  }
+
+#ifdef WITH_IFMA
+  if(type == CPU_ENGINE_IFMA) {
+    SetIFMA(k,&rx,&ry);
+  } else
+#endif
+  {
+    herd->SetX(k,&rx);
+    herd->SetY(k,&ry);
+  }
+  herd->SetD(k,&d);
+  nbEscape++;
+
+  if(((rx.bits64[3] & dpMask[3]) == 0) && ((rx.bits64[2] & dpMask[2]) == 0) &&
+     ((rx.bits64[1] & dpMask[1]) == 0) && ((rx.bits64[0] & dpMask[0]) == 0)) {
+    ITEM it;
+    it.x.Set(&rx);
+    it.d.Set(&d);
+    it.kIdx = k;
+    dpFound.push_back(it);
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUEngine::AddJump(int k,Fe *dxInv) {
+
+  // Using Affine coord
+  Fe px;
+  Fe py;
+  Int d;
+  Fe dy;
+  Fe rx;
+  Fe ry;
+  Fe _s;
+  Fe _p;
+
+  uint64_t jmp = GetJump(k);
+
+  Fe *p1x = &jPx[jmp];
+  Fe *p1y = &jPy[jmp];
+  herd->GetX(k,&px);
+  herd->GetY(k,&py);
+
+  dy.ModSubK1(&py,p1y);
+  _s.ModMulK1(&dy,dxInv);
+  _p.ModSquareK1(&_s);
+
+  rx.ModSubK1(&_p,p1x);
+  rx.ModSubK1(&px);
+
+  ry.ModSubK1(&px,&rx);
+  ry.ModMulK1(&_s);
+  ry.ModSubK1(&py);
+
+  if(narrow) {
+    herd->AddAcc(k,jD64[jmp]);
+  } else {
+    herd->GetD(k,&d);
+    d.ModAddK1order(&jD[jmp]);
+    herd->SetD(k,&d);
+  }
+
+  // Equivalence symmetry class switch
+  if(symmetry && ry.ModPositiveK1()) {
+    if(narrow) herd->FoldD(k);
+    herd->GetD(k,&d);
+    d.ModNegK1order();
+    herd->SetD(k,&d);
+    symClass[k] = !symClass[k];
+  }
+
+  herd->SetX(k,&rx);
+  herd->SetY(k,&ry);
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUEngine::ScanDP(std::vector<ITEM> &dpFound) {
+
+  for(int k = 0; k < nbKangaroo; k++) {
+    if(IsDP(k)) {
+      ITEM it;
+      if(narrow) herd->FoldD(k);
+      herd->GetX(k,&it.x);
+      herd->GetD(k,&it.d);
+      it.kIdx = k;
+      dpFound.push_back(it);
+    }
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUEngine::LaunchScalar(std::vector<ITEM> &dpFound) {
+
+  Fe px;
+
+  for(int t = 0; t < nbKangaroo; t += tileSize) {
+
+    int nb = (nbKangaroo - t < tileSize) ? nbKangaroo - t : tileSize;
+
+    for(int g = 0; g < nb; g++) {
+
+      int k = t + g;
+      uint64_t jmp = GetJump(k);
+
+      herd->GetX(k,&px);
+      dx[g].ModSubK1(&px,&jPx[jmp]);
+
+    }
+    PROF_MARK(PROF_DX);
+
+    IntGroup *tGrp = (nb == tileSize) ? grp : grpLast;
+    tGrp->Set(dx);
+    tGrp->ModInv();
+    PROF_MARK(PROF_INV);
+
+    for(int g = 0; g < nb; g++)
+      AddJump(t + g,&dx[g]);
+    PROF_MARK(PROF_ADD);
+
+  }
+
+  ScanDP(dpFound);
+
+}
@@ -0,0 +1,162 @@
+/*
+* This file is part of the BTCCollider distribution (https://github.com/JeanLucPons/Kangaroo).
+* Copyright (c) 2020 Jean Luc PONS.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CPUENGINEH
+#define CPUENGINEH
+
+#include <vector>
+#include "../Constants.h"
+#include "../SECPK1/SECP256k1.h"
+#include "../SECPK1/IntGroup.h"
+#include "../GPU/GPUEngine.h"
+#include "HerdState.h"
+#include "Profile.h"
+
+// CPU walk engines
+#define CPU_ENGINE_AUTO   -1
+#define CPU_ENGINE_SCALAR  0  // 4x64 bit Fe, one kangaroo at a time
+#define CPU_ENGINE_IFMA    1  // AVX-512 IFMA, 8 kangaroos per instruction (radix 2^52)
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define WITH_IFMA
+#endif
+
+// Number of kangaroo per vector
+#define IFMA_LANE 8
+
+// Below this range size, jumps fit in 64 bits and distances are summed
+// in a narrow accumulator (see HerdState)
+#define NARROW_RANGE_BIT 126
+
+// Fruitless cycle detection window (symmetry), in steps
+#define CYCLE_WINDOW 64
+
+// DP inter-arrival histogram, in units of 2^dpSize steps: bucket 0 holds
+// the lengths below 1/8, bucket i in [2^(i-4),2^(i-3)), the last one 16+
+#define DPL_BUCKET 9
+
+// A kangaroo without DP for STUCK_FACTOR x 2^dpSize steps is reset
+// (geometric tail e^-16), walks are checked every STUCK_PERIOD steps
+#define STUCK_FACTOR 16
+#define STUCK_PERIOD 64
+
+// Close the current profiled phase
+#define PROF_MARK(phase) if(pTick) prof->Mark(phase,&pTick)
+
+class CPUEngine {
+
+public:
+
+  CPUEngine(int nbKangaroo,int type,bool symmetry);
+  ~CPUEngine();
+  void SetParams(Int *dpMask,Int *distance,Int *px,Int *py,int rangePower);
+  void SetEscape(Int *distance,Int *px,Int *py);
+  void SetKangaroos(Int *px,Int *py,Int *d);
+  void SetKangaroos(std::vector<uint64_t> &kIdx,Int *px,Int *py,Int *d);
+  void GetKangaroos(Int *px,Int *py,Int *d);
+  void SetKangaroo(uint64_t kIdx,Int *px,Int *py,Int *d);
+  void Launch(std::vector<ITEM> &dpFound);
+  int GetNbKangaroo();
+  int GetType();
+  bool IsNarrow();
+  uint64_t GetNbEscape();
+  int GetStuck(std::vector<uint64_t> &kIdx);
+  void GetWalkStats(uint64_t *dpHist,uint64_t *stuck);
+  void SetProfile(CPUProfile *prof);
+
+  static double GetExpectedDPL(int bucket,int dpBit);
+
+  static int GetBestType();
+  static bool IsSupported(int type);
+  static const char *GetName(int type);
+
+private:
+
+  bool IsDP(int kIdx);
+  uint64_t GetKey(int kIdx);
+  void CheckCycles(std::vector<ITEM> &dpFound);
+  void UpdateWalkStats(std::vector<ITEM> &dpFound);
+  void Escape(int kIdx,std::vector<ITEM> &dpFound);
+  inline uint64_t GetJump(int kIdx) {
+    return (herd->x[0][kIdx] & jMask) + (NB_JUMP / 2) * symClass[kIdx];
+  }
+  void LaunchScalar(std::vector<ITEM> &dpFound);
+  void AddJump(int kIdx,Fe *dxInv);
+  void ScanDP(std::vector<ITEM> &dpFound);
+#ifdef WITH_IFMA
+  void LaunchIFMA(std::vector<ITEM> &dpFound);
+  void SetIFMA(uint64_t kIdx,Int *x,Int *y);
+  void GetIFMA(uint64_t kIdx,Int *x,Int *y);
+  static void To52(uint64_t *b,int lane,Int *a);
+  static void From52(Int *a,uint64_t *b,int lane);
+#endif
+
+  int type;
+  int nbKangaroo;
+  int tileSize;
+  bool narrow;
+  uint64_t dpMask[4];
+  uint64_t jD64[NB_JUMP];
+  Int jD[NB_JUMP];
+  Fe jPx[NB_JUMP];
+  Fe jPy[NB_JUMP];
+
+  // Herd (position only used by the scalar engine)
+  HerdState *herd;
+  Fe *dx;
+  Fe *subp;
+  IntGroup *grp;
+  IntGroup *grpLast;
+
+  // IFMA herd, [group][limb][lane] in radix 2^52
+  uint64_t *x52;
+  uint64_t *y52;
+  uint64_t *subp52;
+  uint64_t *dx52;
+  uint64_t jPx52[5 * NB_JUMP];
+  uint64_t jPy52[5 * NB_JUMP];
+  uint64_t dpMask52[5];
+  uint8_t *dpFlag;
+
+  // Symmetry: class switch (selects the jump table half) and fruitless
+  // cycle state, symClass stays 0 without symmetry
+  bool symmetry;
+  uint64_t jMask;
+  uint64_t *symClass;
+  uint64_t *cycleKey;
+  uint64_t *cycleMin;
+  uint8_t *cycleState;
+  uint64_t stepCount;
+  uint64_t nbEscape;
+  Int escD;
+  Int escPx;
+  Int escPy;
+
+  // Walk telemetry, step of the last DP (or respawn) of each kangaroo
+  int dpBit;
+  uint64_t nbStep;
+  uint64_t *lastDP;
+  uint64_t dpHist[DPL_BUCKET];
+  uint64_t nbStuck;
+
+  // Phase accounting (-profile), pTick is 0 when the launch is not sampled
+  CPUProfile *prof;
+  uint64_t pTick;
+
+};
+
+#endif // CPUENGINEH
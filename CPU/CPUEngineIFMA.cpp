@@ -0,0 +1,473 @@
+/*
+* This file is part of the BTCCollider distribution (https://github.com/JeanLucPons/Kangaroo).
+* Copyright (c) 2020 Jean Luc PONS.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// AVX-512 IFMA walk: 8 kangaroos per vector, field elements in radix 2^52.
+// Elements are kept "weakly" reduced (limbs < 2^52, value < 2^260) and
+// brought to [0,P) only where bits are inspected (x for jump/DP).
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+// Before Int.h which defines its own __rdtsc() and adx macros
+#include <immintrin.h>
+#define __rdtsc __rdtsc_int
+#endif
+
+#include "CPUEngine.h"
+
+#ifdef WITH_IFMA
+
+#define IFMA __attribute__((target("avx512f,avx512ifma")))
+
+#if defined(__GNUC__) && !defined(__clang__)
+// False positive on _mm512_undefined_epi32() inside gcc intrinsics
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+using namespace std;
+
+typedef struct {
+  __m512i l[5];
+} fe8;
+
+#define MASK52 0xFFFFFFFFFFFFFULL
+#define MASK48 0xFFFFFFFFFFFFULL
+#define R256   0x1000003D1ULL   // 2^256 mod P
+#define R260   0x1000003D10ULL  // 2^260 mod P
+
+// P and (P+1)/2 in radix 2^52
+static const uint64_t P52[5] = { 0xFFFFEFFFFFC2FULL,MASK52,MASK52,MASK52,MASK48 };
+static const uint64_t H52[5] = { 0xFFFFF7FFFFE18ULL,MASK52,MASK52,MASK52,0x7FFFFFFFFFFFULL };
+
+#define GROUP_SIZE (5 * IFMA_LANE)
+
+// ----------------------------------------------------------------------------
+
+IFMA static inline void Load(fe8 *r,const uint64_t *b) {
+  for(int i = 0; i < 5; i++) r->l[i] = _mm512_load_si512((const void *)(b + i * IFMA_LANE));
+}
+
+IFMA static inline void Store(uint64_t *b,const fe8 *r) {
+  for(int i = 0; i < 5; i++) _mm512_store_si512((void *)(b + i * IFMA_LANE),r->l[i]);
+}
+
+// Limbs < 2^63 => limbs < 2^52, value < 2^260
+IFMA static inline void Norm(fe8 *r) {
+
+  const __m512i m = _mm512_set1_epi64(MASK52);
+  const __m512i k = _mm512_set1_epi64(R260);
+  __m512i c;
+
+  for(int pass = 0; pass < 2; pass++) {
+    for(int i = 0; i < 4; i++) {
+      c = _mm512_srli_epi64(r->l[i],52);
+      r->l[i] = _mm512_and_si512(r->l[i],m);
+      r->l[i + 1] = _mm512_add_epi64(r->l[i + 1],c);
+    }
+    c = _mm512_srli_epi64(r->l[4],52);
+    r->l[4] = _mm512_and_si512(r->l[4],m);
+    // Second fold only happens when the value left is below 2^49
+    r->l[0] = _mm512_madd52lo_epu64(r->l[0],c,k);
+  }
+
+}
+
+// Reduce 10 columns (each < 2^57) to 5 limbs
+IFMA static inline void Reduce(fe8 *r,__m512i *t) {
+
+  const __m512i m = _mm512_set1_epi64(MASK52);
+  const __m512i k = _mm512_set1_epi64(R260);
+  const __m512i z = _mm512_setzero_si512();
+  __m512i c;
+  __m512i r5;
+
+  for(int i = 0; i < 9; i++) {
+    c = _mm512_srli_epi64(t[i],52);
+    t[i] = _mm512_and_si512(t[i],m);
+    t[i + 1] = _mm512_add_epi64(t[i + 1],c);
+  }
+
+  // t[5..9]*2^260 = t[5..9]*R260
+  r->l[0] = _mm512_madd52lo_epu64(t[0],t[5],k);
+  r->l[1] = _mm512_madd52hi_epu64(t[1],t[5],k);
+  r->l[1] = _mm512_madd52lo_epu64(r->l[1],t[6],k);
+  r->l[2] = _mm512_madd52hi_epu64(t[2],t[6],k);
+  r->l[2] = _mm512_madd52lo_epu64(r->l[2],t[7],k);
+  r->l[3] = _mm512_madd52hi_epu64(t[3],t[7],k);
+  r->l[3] = _mm512_madd52lo_epu64(r->l[3],t[8],k);
+  r->l[4] = _mm512_madd52hi_epu64(t[4],t[8],k);
+  r->l[4] = _mm512_madd52lo_epu64(r->l[4],t[9],k);
+  r5 = _mm512_madd52hi_epu64(z,t[9],k);
+
+  for(int i = 0; i < 4; i++) {
+    c = _mm512_srli_epi64(r->l[i],52);
+    r->l[i] = _mm512_and_si512(r->l[i],m);
+    r->l[i + 1] = _mm512_add_epi64(r->l[i + 1],c);
+  }
+  c = _mm512_srli_epi64(r->l[4],52);
+  r->l[4] = _mm512_and_si512(r->l[4],m);
+  r5 = _mm512_add_epi64(r5,c);
+
+  r->l[0] = _mm512_madd52lo_epu64(r->l[0],r5,k);
+  r->l[1] = _mm512_madd52hi_epu64(r->l[1],r5,k);
+
+  for(int i = 0; i < 4; i++) {
+    c = _mm512_srli_epi64(r->l[i],52);
+    r->l[i] = _mm512_and_si512(r->l[i],m);
+    r->l[i + 1] = _mm512_add_epi64(r->l[i + 1],c);
+  }
+  c = _mm512_srli_epi64(r->l[4],52);
+  r->l[4] = _mm512_and_si512(r->l[4],m);
+
+  // Value left is below 2^75 when c is set
+  r->l[0] = _mm512_madd52lo_epu64(r->l[0],c,k);
+  r->l[1] = _mm512_add_epi64(r->l[1],_mm512_srli_epi64(r->l[0],52));
+  r->l[0] = _mm512_and_si512(r->l[0],m);
+
+}
+
+IFMA static inline void ModMul(fe8 *r,const fe8 *a,const fe8 *b) {
+
+  __m512i t[10];
+  for(int i = 0; i < 10; i++) t[i] = _mm512_setzero_si512();
+
+  for(int i = 0; i < 5; i++) {
+    for(int j = 0; j < 5; j++) {
+      t[i + j] = _mm512_madd52lo_epu64(t[i + j],a->l[i],b->l[j]);
+      t[i + j + 1] = _mm512_madd52hi_epu64(t[i + j + 1],a->l[i],b->l[j]);
+    }
+  }
+
+  Reduce(r,t);
+
+}
+
+IFMA static inline void ModSquare(fe8 *r,const fe8 *a) {
+
+  __m512i t[10];
+  for(int i = 0; i < 10; i++) t[i] = _mm512_setzero_si512();
+
+  for(int i = 0; i < 5; i++) {
+    for(int j = i + 1; j < 5; j++) {
+      t[i + j] = _mm512_madd52lo_epu64(t[i + j],a->l[i],a->l[j]);
+      t[i + j + 1] = _mm512_madd52hi_epu64(t[i + j + 1],a->l[i],a->l[j]);
+    }
+  }
+  for(int i = 0; i < 10; i++) t[i] = _mm512_add_epi64(t[i],t[i]);
+  for(int i = 0; i < 5; i++) {
+    t[2 * i] = _mm512_madd52lo_epu64(t[2 * i],a->l[i],a->l[i]);
+    t[2 * i + 1] = _mm512_madd52hi_epu64(t[2 * i + 1],a->l[i],a->l[i]);
+  }
+
+  Reduce(r,t);
+
+}
+
+// r = a - b
+IFMA static inline void ModSub(fe8 *r,const fe8 *a,const fe8 *b) {
+
+  // 32*P has all limbs >= 2^52
+  for(int i = 0; i < 5; i++) {
+    __m512i p = _mm512_set1_epi64(P52[i] << 5);
+    r->l[i] = _mm512_sub_epi64(_mm512_add_epi64(a->l[i],p),b->l[i]);
+  }
+  Norm(r);
+
+}
+
+// r = a - b - c
+IFMA static inline void ModSub2(fe8 *r,const fe8 *a,const fe8 *b,const fe8 *c) {
+
+  for(int i = 0; i < 5; i++) {
+    __m512i p = _mm512_set1_epi64(P52[i] << 6);
+    r->l[i] = _mm512_sub_epi64(_mm512_sub_epi64(_mm512_add_epi64(a->l[i],p),b->l[i]),c->l[i]);
+  }
+  Norm(r);
+
+}
+
+// Bring to [0,P)
+IFMA static inline void Canonical(fe8 *r) {
+
+  const __m512i m = _mm512_set1_epi64(MASK52);
+  const __m512i m48 = _mm512_set1_epi64(MASK48);
+  const __m512i k = _mm512_set1_epi64(R256);
+  __m512i c;
+  __m512i t[5];
+
+  for(int pass = 0; pass < 2; pass++) {
+    c = _mm512_srli_epi64(r->l[4],48);
+    r->l[4] = _mm512_and_si512(r->l[4],m48);
+    r->l[0] = _mm512_madd52lo_epu64(r->l[0],c,k);
+    if(pass == 0) {
+      for(int i = 0; i < 4; i++) {
+        c = _mm512_srli_epi64(r->l[i],52);
+        r->l[i] = _mm512_and_si512(r->l[i],m);
+        r->l[i + 1] = _mm512_add_epi64(r->l[i + 1],c);
+      }
+    }
+  }
+
+  // x >= P <=> x + 2^256 - P >= 2^256
+  t[0] = _mm512_add_epi64(r->l[0],k);
+  for(int i = 0; i < 4; i++) {
+    c = _mm512_srli_epi64(t[i],52);
+    t[i] = _mm512_and_si512(t[i],m);
+    t[i + 1] = _mm512_add_epi64(r->l[i + 1],c);
+  }
+  __mmask8 ge = _mm512_test_epi64_mask(t[4],_mm512_set1_epi64(1ULL << 48));
+  for(int i = 0; i < 4; i++)
+    r->l[i] = _mm512_mask_mov_epi64(r->l[i],ge,t[i]);
+  r->l[4] = _mm512_mask_mov_epi64(r->l[4],ge,_mm512_and_si512(t[4],m48));
+
+}
+
+// Lanes where r >= (P+1)/2 (r canonical), those lanes get P-r
+IFMA static inline __mmask8 ModPositive(fe8 *r) {
+
+  const __m512i m = _mm512_set1_epi64(MASK52);
+  __m512i b = _mm512_setzero_si512();
+  __m512i d;
+
+  for(int i = 0; i < 5; i++) {
+    d = _mm512_add_epi64(_mm512_sub_epi64(r->l[i],_mm512_set1_epi64(H52[i])),b);
+    b = _mm512_srai_epi64(d,52);
+  }
+  __mmask8 flip = _mm512_cmpge_epi64_mask(d,_mm512_setzero_si512());
+
+  b = _mm512_setzero_si512();
+  for(int i = 0; i < 5; i++) {
+    d = _mm512_add_epi64(_mm512_sub_epi64(_mm512_set1_epi64(P52[i]),r->l[i]),b);
+    b = _mm512_srai_epi64(d,52);
+    r->l[i] = _mm512_mask_mov_epi64(r->l[i],flip,_mm512_and_si512(d,m));
+  }
+
+  return flip;
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUEngine::To52(uint64_t *b,int lane,Int *a) {
+
+  uint64_t *s = a->bits64;
+  b[lane] = s[0] & MASK52;
+  b[lane + IFMA_LANE] = ((s[0] >> 52) | (s[1] << 12)) & MASK52;
+  b[lane + 2 * IFMA_LANE] = ((s[1] >> 40) | (s[2] << 24)) & MASK52;
+  b[lane + 3 * IFMA_LANE] = ((s[2] >> 28) | (s[3] << 36)) & MASK52;
+  b[lane + 4 * IFMA_LANE] = s[3] >> 16;
+
+}
+
+void CPUEngine::From52(Int *a,uint64_t *b,int lane) {
+
+  a->bits64[0] = b[lane] | (b[lane + IFMA_LANE] << 52);
+  a->bits64[1] = (b[lane + IFMA_LANE] >> 12) | (b[lane + 2 * IFMA_LANE] << 40);
+  a->bits64[2] = (b[lane + 2 * IFMA_LANE] >> 24) | (b[lane + 3 * IFMA_LANE] << 28);
+  a->bits64[3] = (b[lane + 3 * IFMA_LANE] >> 36) | (b[lane + 4 * IFMA_LANE] << 16);
+  a->bits64[4] = 0;
+
+}
+
+void CPUEngine::SetIFMA(uint64_t kIdx,Int *x,Int *y) {
+
+  uint64_t g = kIdx / IFMA_LANE;
+  int lane = (int)(kIdx % IFMA_LANE);
+  To52(x52 + g * GROUP_SIZE,lane,x);
+  To52(y52 + g * GROUP_SIZE,lane,y);
+
+}
+
+IFMA void CPUEngine::GetIFMA(uint64_t kIdx,Int *x,Int *y) {
+
+  alignas(64) uint64_t tmp[GROUP_SIZE];
+  uint64_t g = kIdx / IFMA_LANE;
+  int lane = (int)(kIdx % IFMA_LANE);
+  fe8 v;
+
+  From52(x,x52 + g * GROUP_SIZE,lane);
+  Load(&v,y52 + g * GROUP_SIZE);
+  Canonical(&v);
+  Store(tmp,&v);
+  From52(y,tmp,lane);
+
+}
+
+// ----------------------------------------------------------------------------
+
+IFMA void CPUEngine::LaunchIFMA(std::vector<ITEM> &dpFound) {
+
+  alignas(64) uint64_t tmp[GROUP_SIZE];
+  alignas(64) uint64_t jmp[IFMA_LANE];
+  Int lInv[IFMA_LANE];
+  Int d;
+  int nbGroup = nbKangaroo / IFMA_LANE;
+  int tileGroup = tileSize / IFMA_LANE;
+
+  fe8 x;
+  fe8 y;
+  fe8 jx;
+  fe8 jy;
+  fe8 dx;
+  fe8 dy;
+  fe8 acc;
+  fe8 inv;
+  fe8 s;
+  fe8 p;
+  fe8 rx;
+  fe8 ry;
+
+  // symClass is 0 without symmetry
+  const __m512i vjMask = _mm512_set1_epi64(jMask);
+#define GET_JUMP(g) \
+  __m512i idx = _mm512_add_epi64(_mm512_and_si512(x.l[0],vjMask), \
+    _mm512_slli_epi64(_mm512_loadu_si512((const void *)(symClass + (g) * IFMA_LANE)),__builtin_ctz(NB_JUMP / 2)));
+
+  for(int t = 0; t < nbGroup; t += tileGroup) {
+
+    int tEnd = (t + tileGroup < nbGroup) ? t + tileGroup : nbGroup;
+
+    // dx = x - jx and lane-wise prefix products
+    for(int g = t; g < tEnd; g++) {
+
+      Load(&x,x52 + g * GROUP_SIZE);
+      GET_JUMP(g);
+      for(int i = 0; i < 5; i++)
+        jx.l[i] = _mm512_i64gather_epi64(idx,(const void *)(jPx52 + i * NB_JUMP),8);
+      ModSub(&dx,&x,&jx);
+      Store(dx52 + g * GROUP_SIZE,&dx);
+      if(g == t) acc = dx;
+      else       ModMul(&acc,&acc,&dx);
+      Store(subp52 + g * GROUP_SIZE,&acc);
+
+    }
+    PROF_MARK(PROF_DX);
+
+    // Invert the 8 lane products
+    Canonical(&acc);
+    Store(tmp,&acc);
+    for(int j = 0; j < IFMA_LANE; j++) From52(&lInv[j],tmp,j);
+    grp->Set(lInv);
+    grp->ModInv();
+    for(int j = 0; j < IFMA_LANE; j++) To52(tmp,j,&lInv[j]);
+    Load(&inv,tmp);
+    PROF_MARK(PROF_INV);
+
+    // Back substitution and point addition
+    for(int g = tEnd - 1; g >= t; g--) {
+
+      if(g > t) {
+        Load(&dx,subp52 + (g - 1) * GROUP_SIZE);
+        ModMul(&s,&dx,&inv);
+        Load(&dx,dx52 + g * GROUP_SIZE);
+        ModMul(&inv,&inv,&dx);
+        dx = s;
+      } else {
+        dx = inv;
+      }
+
+      uint64_t *xg = x52 + g * GROUP_SIZE;
+      uint64_t *yg = y52 + g * GROUP_SIZE;
+      Load(&x,xg);
+      Load(&y,yg);
+      GET_JUMP(g);
+      _mm512_store_si512((void *)jmp,idx);
+      for(int i = 0; i < 5; i++) {
+        jx.l[i] = _mm512_i64gather_epi64(idx,(const void *)(jPx52 + i * NB_JUMP),8);
+        jy.l[i] = _mm512_i64gather_epi64(idx,(const void *)(jPy52 + i * NB_JUMP),8);
+      }
+
+      ModSub(&dy,&y,&jy);
+      ModMul(&s,&dy,&dx);
+      ModSquare(&p,&s);
+
+      ModSub2(&rx,&p,&jx,&x);
+      Canonical(&rx);
+
+      ModSub(&ry,&x,&rx);
+      ModMul(&ry,&ry,&s);
+      ModSub(&ry,&ry,&y);
+
+      // Equivalence symmetry class switch
+      __mmask8 flip = 0;
+      if(symmetry) {
+        Canonical(&ry);
+        flip = ModPositive(&ry);
+      }
+
+      if(narrow) {
+        // 128-bit accumulator, 8 lanes
+        int k = g * IFMA_LANE;
+        __m512i jd = _mm512_i64gather_epi64(idx,(const void *)jD64,8);
+        __m512i a0 = _mm512_load_si512((const void *)(herd->acc[0] + k));
+        __m512i a1 = _mm512_load_si512((const void *)(herd->acc[1] + k));
+        a0 = _mm512_add_epi64(a0,jd);
+        a1 = _mm512_mask_add_epi64(a1,_mm512_cmplt_epu64_mask(a0,jd),a1,_mm512_set1_epi64(1));
+        _mm512_store_si512((void *)(herd->acc[0] + k),a0);
+        _mm512_store_si512((void *)(herd->acc[1] + k),a1);
+      } else {
+        for(int j = 0; j < IFMA_LANE; j++) {
+          int k = g * IFMA_LANE + j;
+          herd->GetD(k,&d);
+          d.ModAddK1order(&jD[jmp[j]]);
+          herd->SetD(k,&d);
+        }
+      }
+      for(int j = 0; flip && j < IFMA_LANE; j++) {
+        if(flip & (1 << j)) {
+          int k = g * IFMA_LANE + j;
+          if(narrow) herd->FoldD(k);
+          herd->GetD(k,&d);
+          d.ModNegK1order();
+          herd->SetD(k,&d);
+          symClass[k] = !symClass[k];
+        }
+      }
+
+      Store(xg,&rx);
+      Store(yg,&ry);
+
+      __m512i dp = _mm512_setzero_si512();
+      for(int i = 0; i < 5; i++)
+        dp = _mm512_or_si512(dp,_mm512_and_si512(rx.l[i],_mm512_set1_epi64(dpMask52[i])));
+      dpFlag[g] = (uint8_t)_mm512_testn_epi64_mask(dp,dp);
+
+    }
+    PROF_MARK(PROF_ADD);
+
+  }
+
+#undef GET_JUMP
+
+  for(int g = 0; g < nbGroup; g++) {
+    if(dpFlag[g]) {
+      for(int j = 0; j < IFMA_LANE; j++) {
+        if(dpFlag[g] & (1 << j)) {
+          ITEM it;
+          int k = g * IFMA_LANE + j;
+          if(narrow) herd->FoldD(k);
+          From52(&it.x,x52 + g * GROUP_SIZE,j);
+          herd->GetD(k,&it.d);
+          it.kIdx = k;
+          dpFound.push_back(it);
+        }
+      }
+    }
+  }
+
+}
+
+#endif // WITH_IFMA
@@ -0,0 +1,107 @@
+/*
+* This file is part of the BTCCollider distribution (https://github.com/JeanLucPons/Kangaroo).
+* Copyright (c) 2020 Jean Luc PONS.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HerdState.h"
+#include "../HugePage.h"
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN64
+#include <unistd.h>
+#endif
+
+// ----------------------------------------------------------------------------
+
+HerdState::HerdState(int nbKangaroo,bool withPosition) {
+
+  this->nbKangaroo = nbKangaroo;
+
+  // Planes padded to a whole number of cache lines
+  size_t planeSize = (((size_t)nbKangaroo * 8 + HERD_ALIGN - 1) / HERD_ALIGN) * HERD_ALIGN;
+  int nbPlane = withPosition ? 14 : 6;
+  // Zeroed, aligned, on huge pages if available
+  blockSize = planeSize * nbPlane;
+  block = (uint8_t *)HugePage::Alloc(blockSize);
+  uint8_t *p = block;
+
+  for(int i = 0; i < 4; i++) {
+    d[i] = (uint64_t *)p;
+    p += planeSize;
+  }
+  for(int i = 0; i < 2; i++) {
+    acc[i] = (uint64_t *)p;
+    p += planeSize;
+  }
+  for(int i = 0; i < 4; i++) {
+    if(withPosition) {
+      x[i] = (uint64_t *)p;
+      y[i] = (uint64_t *)(p + 4 * planeSize);
+      p += planeSize;
+    } else {
+      x[i] = NULL;
+      y[i] = NULL;
+    }
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
+HerdState::~HerdState() {
+  HugePage::Free(block,blockSize);
+}
+
+// ----------------------------------------------------------------------------
+
+void HerdState::FoldD(int i) {
+
+  if(acc[0][i] == 0 && acc[1][i] == 0)
+    return;
+
+  Int a;
+  Int dist;
+  a.SetInt32(0);
+  a.bits64[0] = acc[0][i];
+  a.bits64[1] = acc[1][i];
+  GetD(i,&dist);
+  dist.ModAddK1order(&a);
+  SetD(i,&dist);
+  ClearAcc(i);
+
+}
+
+// ----------------------------------------------------------------------------
+
+int HerdState::GetTileSize(int nbKangaroo,int bytePerKangaroo,int multiple) {
+
+  long l2 = 0;
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+  l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+  if(l2 <= 0) l2 = 256 * 1024;
+
+  // Half of L2 for the walk working set, the rest for jump table, stack...
+  int tile = (int)((l2 / 2) / bytePerKangaroo);
+  if(tile < 256) tile = 256;
+  if(tile >= nbKangaroo) return nbKangaroo;
+
+  // Even tiles
+  int nbTile = (nbKangaroo + tile - 1) / tile;
+  tile = (nbKangaroo + nbTile - 1) / nbTile;
+  tile = ((tile + multiple - 1) / multiple) * multiple;
+  return tile;
+
+}
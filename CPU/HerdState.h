@@ -0,0 +1,105 @@
+/*
+* This file is part of the BTCCollider distribution (https://github.com/JeanLucPons/Kangaroo).
+* Copyright (c) 2020 Jean Luc PONS.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HERDSTATEH
+#define HERDSTATEH
+
+#include "../SECPK1/Int.h"
+#include "../SECPK1/Fe.h"
+
+// Plane alignment (bytes)
+#define HERD_ALIGN 64
+
+// Kangaroo herd stored as structure of arrays: one aligned plane per
+// 64-bit limb of x, y and distance. The herd is walked tile by tile, a
+// tile being the number of kangaroos whose working set fits in L2.
+// For narrow ranges, jumps are summed in a 128-bit accumulator (acc)
+// which is folded into the distance (mod order) only when needed.
+class HerdState {
+
+public:
+
+  HerdState(int nbKangaroo,bool withPosition = true);
+  ~HerdState();
+
+  static int GetTileSize(int nbKangaroo,int bytePerKangaroo,int multiple);
+
+  inline void GetX(int i,Int *r) { Load(x,i,r); }
+  inline void GetY(int i,Int *r) { Load(y,i,r); }
+  inline void GetD(int i,Int *r) { Load(d,i,r); }
+  inline void SetX(int i,Int *r) { Store(x,i,r); }
+  inline void SetY(int i,Int *r) { Store(y,i,r); }
+  inline void SetD(int i,Int *r) { Store(d,i,r); }
+  inline void GetX(int i,Fe *r) { Load(x,i,r); }
+  inline void GetY(int i,Fe *r) { Load(y,i,r); }
+  inline void SetX(int i,Fe *r) { Store(x,i,r); }
+  inline void SetY(int i,Fe *r) { Store(y,i,r); }
+
+  inline void AddAcc(int i,uint64_t j) {
+    uint64_t s = acc[0][i] + j;
+    acc[1][i] += (s < j);
+    acc[0][i] = s;
+  }
+  inline void ClearAcc(int i) {
+    acc[0][i] = 0;
+    acc[1][i] = 0;
+  }
+  void FoldD(int i);
+
+  int nbKangaroo;
+  uint64_t *x[4];
+  uint64_t *y[4];
+  uint64_t *d[4];
+  uint64_t *acc[2];
+
+private:
+
+  inline void Load(uint64_t **p,int i,Int *r) {
+    r->bits64[0] = p[0][i];
+    r->bits64[1] = p[1][i];
+    r->bits64[2] = p[2][i];
+    r->bits64[3] = p[3][i];
+    r->bits64[4] = 0;
+  }
+
+  inline void Store(uint64_t **p,int i,Int *r) {
+    p[0][i] = r->bits64[0];
+    p[1][i] = r->bits64[1];
+    p[2][i] = r->bits64[2];
+    p[3][i] = r->bits64[3];
+  }
+
+  inline void Load(uint64_t **p,int i,Fe *r) {
+    r->v[0] = p[0][i];
+    r->v[1] = p[1][i];
+    r->v[2] = p[2][i];
+    r->v[3] = p[3][i];
+  }
+
+  inline void Store(uint64_t **p,int i,Fe *r) {
+    p[0][i] = r->v[0];
+    p[1][i] = r->v[1];
+    p[2][i] = r->v[2];
+    p[3][i] = r->v[3];
+  }
+
+  uint8_t *block;
+  size_t blockSize;
+
+};
+
+#endif // HERDSTATEH
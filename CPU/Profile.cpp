@@ -0,0 +1,151 @@
+/*
+* This file is part of the BTCCollider distribution (https://github.com/JeanLucPons/Kangaroo).
+* Copyright (c) 2020 Jean Luc PONS.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Profile.h"
+#include <string.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// ----------------------------------------------------------------------------
+
+CPUProfile::CPUProfile() {
+
+  sampling = false;
+  hwOk = false;
+  nbIter = 0;
+  nbSample = 0;
+  nbStep = 0;
+  memset(cycles,0,sizeof(cycles));
+  memset(hw,0,sizeof(hw));
+  memset(hwStart,0,sizeof(hwStart));
+  for(int i = 0; i < PROF_NB_HW; i++)
+    fd[i] = -1;
+
+}
+
+CPUProfile::~CPUProfile() {
+
+#ifdef __linux__
+  for(int i = 0; i < PROF_NB_HW; i++)
+    if(fd[i] >= 0) close(fd[i]);
+#endif
+
+}
+
+// ----------------------------------------------------------------------------
+
+const char *CPUProfile::GetPhaseName(int phase) {
+
+  const char *names[PROF_NB_PHASE] = { "dx","inv","add","dp","stage","send","wait","lock","table" };
+  return (phase >= 0 && phase < PROF_NB_PHASE) ? names[phase] : "?";
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUProfile::Open() {
+
+#ifdef __linux__
+
+  // User space counters of this thread, one group led by the cycles
+  uint64_t config[PROF_NB_HW] = {
+    PERF_COUNT_HW_CPU_CYCLES,PERF_COUNT_HW_INSTRUCTIONS,PERF_COUNT_HW_CACHE_MISSES
+  };
+
+  // Counters of a previous (parked) worker of the slot
+  for(int i = 0; i < PROF_NB_HW; i++) {
+    if(fd[i] >= 0) close(fd[i]);
+    fd[i] = -1;
+  }
+
+  hwOk = true;
+  for(int i = 0; i < PROF_NB_HW && hwOk; i++) {
+    struct perf_event_attr attr;
+    memset(&attr,0,sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config[i];
+    attr.disabled = (i == 0);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    fd[i] = (int)syscall(__NR_perf_event_open,&attr,0,-1,(i == 0) ? -1 : fd[0],0);
+    hwOk = fd[i] >= 0;
+  }
+
+  if(hwOk) {
+    ioctl(fd[0],PERF_EVENT_IOC_RESET,PERF_IOC_FLAG_GROUP);
+    ioctl(fd[0],PERF_EVENT_IOC_ENABLE,PERF_IOC_FLAG_GROUP);
+  } else {
+    for(int i = 0; i < PROF_NB_HW; i++) {
+      if(fd[i] >= 0) close(fd[i]);
+      fd[i] = -1;
+    }
+  }
+
+#endif
+
+}
+
+// ----------------------------------------------------------------------------
+
+bool CPUProfile::ReadHW(uint64_t *v) {
+
+#ifdef __linux__
+  // PERF_FORMAT_GROUP: nr, then the values
+  uint64_t buff[1 + PROF_NB_HW];
+  if(read(fd[0],buff,sizeof(buff)) != (ssize_t)sizeof(buff) || buff[0] != PROF_NB_HW)
+    return false;
+  for(int i = 0; i < PROF_NB_HW; i++)
+    v[i] = buff[1 + i];
+  return true;
+#else
+  (void)v;
+  return false;
+#endif
+
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUProfile::StartSample() {
+
+  sampling = (nbIter++ % PROF_SAMPLE) == 0;
+  if(sampling && hwOk)
+    hwOk = ReadHW(hwStart);
+
+}
+
+void CPUProfile::EndSample(uint64_t nbStep) {
+
+  if(!sampling)
+    return;
+
+  uint64_t v[PROF_NB_HW];
+  if(hwOk && (hwOk = ReadHW(v))) {
+    for(int i = 0; i < PROF_NB_HW; i++)
+      hw[i] += v[i] - hwStart[i];
+  }
+  nbSample++;
+  this->nbStep += nbStep;
+  sampling = false;
+
+}
@@ -0,0 +1,95 @@
+/*
+* This file is part of the BTCCollider distribution (https://github.com/JeanLucPons/Kangaroo).
+* Copyright (c) 2020 Jean Luc PONS.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROFILEH
+#define PROFILEH
+
+#include <stdint.h>
+#include "../SECPK1/Int.h"  // __rdtsc()
+
+// Walk loop phases
+#define PROF_DX    0  // dx = x - jx (and prefix products)
+#define PROF_INV   1  // Batch inversion
+#define PROF_ADD   2  // Back substitution and point addition
+#define PROF_DP    3  // DP scan, cycle check, walk stats
+#define PROF_STAGE 4  // DP staging, dead/stuck kangaroo respawn
+#define PROF_SEND  5  // Send to server (client), including ghMutex wait
+#define PROF_WAIT  6  // Save request wait
+#define PROF_LOCK  7  // Flush thread: ghMutex wait
+#define PROF_TABLE 8  // Flush thread: AddToTable
+#define PROF_NB_PHASE 9
+
+// Hardware counters
+#define PROF_HW_CYCLE 0
+#define PROF_HW_INSTR 1
+#define PROF_HW_MISS  2  // Last level cache misses
+#define PROF_NB_HW    3
+
+// One walk loop iteration profiled every PROF_SAMPLE
+#define PROF_SAMPLE 8
+
+// Per thread cycle accounting (rdtsc) of the sampled iterations, and
+// hardware counters (perf_event_open) where the kernel allows it.
+// Counters are written by the owner thread only.
+class CPUProfile {
+
+public:
+
+  CPUProfile();
+  ~CPUProfile();
+
+  // Open the hardware counters of the calling thread
+  void Open();
+
+  // Sampled iteration, nbStep kangaroo steps
+  void StartSample();
+  void EndSample(uint64_t nbStep);
+
+  // Current tick, 0 when not sampling
+  inline uint64_t Begin() {
+    return sampling ? __rdtsc() : 0;
+  }
+
+  // Close a phase started at *tick and start the next one
+  inline void Mark(int phase,uint64_t *tick) {
+    if(*tick) {
+      uint64_t t = __rdtsc();
+      cycles[phase] += t - *tick;
+      *tick = t;
+    }
+  }
+
+  static const char *GetPhaseName(int phase);
+
+  bool sampling;
+  bool hwOk;
+  uint64_t nbIter;
+  uint64_t nbSample;
+  uint64_t nbStep;
+  uint64_t cycles[PROF_NB_PHASE];
+  uint64_t hw[PROF_NB_HW];
+
+private:
+
+  bool ReadHW(uint64_t *v);
+
+  int fd[PROF_NB_HW];
+  uint64_t hwStart[PROF_NB_HW];
+
+};
+
+#endif // PROFILEH
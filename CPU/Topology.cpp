@@ -0,0 +1,210 @@
+/*
+* This file is part of the BTCCollider distribution (https://github.com/JeanLucPons/Kangaroo).
+* Copyright (c) 2020 Jean Luc PONS.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Topology.h"
+#include "../Timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN64
+#include <windows.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+#ifdef __linux__
+
+static bool ReadLine(const char *fileName,char *buff,int size) {
+
+  FILE *f = fopen(fileName,"r");
+  if(f == NULL)
+    return false;
+  bool ok = fgets(buff,size,f) != NULL;
+  fclose(f);
+  return ok;
+
+}
+
+#endif
+
+// ----------------------------------------------------------------------------
+
+void CPUTopology::ParseList(const char *str,vector<int> &list) {
+
+  // sysfs cpu list, e.g. "0-3,8-11"
+  const char *p = str;
+  while(*p) {
+    char *end;
+    long a = strtol(p,&end,10);
+    if(end == p) break;
+    long b = a;
+    p = end;
+    if(*p == '-') {
+      p++;
+      b = strtol(p,&end,10);
+      p = end;
+    }
+    for(long i = a; i <= b; i++)
+      list.push_back((int)i);
+    if(*p == ',') p++;
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
+CPUTopology::CPUTopology() {
+
+  vector<int> allowed;
+  nbNode = 1;
+
+#if defined(WIN64)
+
+  int nbCPU = Timer::getCoreNumber();
+  for(int i = 0; i < nbCPU && i < 64; i++)
+    allowed.push_back(i);
+
+#elif defined(__linux__)
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if(sched_getaffinity(0,sizeof(set),&set) == 0) {
+    for(int i = 0; i < CPU_SETSIZE; i++)
+      if(CPU_ISSET(i,&set)) allowed.push_back(i);
+  }
+  if(allowed.size() == 0) {
+    int nbCPU = Timer::getCoreNumber();
+    for(int i = 0; i < nbCPU; i++)
+      allowed.push_back(i);
+  }
+
+#else
+
+  // No affinity or sysfs, all the cores on a single node
+  int nbCPU = Timer::getCoreNumber();
+  for(int i = 0; i < nbCPU; i++)
+    allowed.push_back(i);
+
+#endif
+
+  int maxCPU = 0;
+  for(int i = 0; i < (int)allowed.size(); i++)
+    if(allowed[i] > maxCPU) maxCPU = allowed[i];
+  nodeOf.assign(maxCPU + 1,0);
+  vector<int> smtRank(maxCPU + 1,0);
+
+#ifdef __linux__
+
+  char buff[1024];
+
+  // NUMA nodes
+  for(int n = 0; n < MAX_NODE; n++) {
+    char fileName[128];
+    snprintf(fileName,sizeof(fileName),"/sys/devices/system/node/node%d/cpulist",n);
+    if(!ReadLine(fileName,buff,sizeof(buff)))
+      continue;
+    vector<int> cpus;
+    ParseList(buff,cpus);
+    for(int i = 0; i < (int)cpus.size(); i++)
+      if(cpus[i] <= maxCPU) nodeOf[cpus[i]] = n;
+    nbNode = n + 1;
+  }
+
+  // SMT siblings, rank 0 is the first logical cpu of the core
+  for(int i = 0; i < (int)allowed.size(); i++) {
+    char fileName[128];
+    snprintf(fileName,sizeof(fileName),"/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list",allowed[i]);
+    if(!ReadLine(fileName,buff,sizeof(buff)))
+      continue;
+    vector<int> siblings;
+    ParseList(buff,siblings);
+    for(int j = 0; j < (int)siblings.size(); j++)
+      if(siblings[j] == allowed[i]) smtRank[allowed[i]] = j;
+  }
+
+#endif
+
+  // Placement order: by SMT rank, then round robin over the nodes
+  int maxRank = 0;
+  for(int i = 0; i < (int)allowed.size(); i++)
+    if(smtRank[allowed[i]] > maxRank) maxRank = smtRank[allowed[i]];
+
+  for(int r = 0; r <= maxRank; r++) {
+    vector< vector<int> > perNode(nbNode);
+    size_t nb = 0;
+    for(int i = 0; i < (int)allowed.size(); i++) {
+      int c = allowed[i];
+      if(smtRank[c] == r) {
+        perNode[nodeOf[c]].push_back(c);
+        nb++;
+      }
+    }
+    for(size_t j = 0; nb > 0; j++) {
+      for(int n = 0; n < nbNode; n++) {
+        if(j < perNode[n].size()) {
+          order.push_back(perNode[n][j]);
+          nb--;
+        }
+      }
+    }
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
+int CPUTopology::GetNbNode() {
+  return nbNode;
+}
+
+int CPUTopology::GetNbCPU() {
+  return (int)order.size();
+}
+
+int CPUTopology::GetCPU(int workerIdx) {
+  return order[workerIdx % order.size()];
+}
+
+int CPUTopology::GetNode(int cpu) {
+  if(cpu < 0 || cpu >= (int)nodeOf.size())
+    return 0;
+  return nodeOf[cpu];
+}
+
+// ----------------------------------------------------------------------------
+
+bool CPUTopology::Pin(int cpu) {
+
+#if defined(WIN64)
+  return SetThreadAffinityMask(GetCurrentThread(),(DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu,&set);
+  return pthread_setaffinity_np(pthread_self(),sizeof(set),&set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+
+}
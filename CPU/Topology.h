@@ -0,0 +1,53 @@
+/*
+* This file is part of the BTCCollider distribution (https://github.com/JeanLucPons/Kangaroo).
+* Copyright (c) 2020 Jean Luc PONS.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOPOLOGYH
+#define TOPOLOGYH
+
+#include <vector>
+
+// Max number of NUMA node reported
+#define MAX_NODE 16
+
+// CPU/NUMA topology (Linux sysfs) and worker placement.
+// Workers are placed one per physical core first, interleaved over the
+// nodes, then on the SMT siblings.
+class CPUTopology {
+
+public:
+
+  CPUTopology();
+
+  int GetNbNode();
+  int GetNbCPU();
+  int GetCPU(int workerIdx);
+  int GetNode(int cpu);
+
+  // Pin the calling thread, false on failure
+  static bool Pin(int cpu);
+
+private:
+
+  void ParseList(const char *str,std::vector<int> &list);
+
+  int nbNode;
+  std::vector<int> order;
+  std::vector<int> nodeOf;
+
+};
+
+#endif // TOPOLOGYH
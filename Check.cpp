@@ -410,6 +410,228 @@ void Kangaroo::CheckWorkFile(int nbCore,std::string& fileName) {
 }
 
 
+// Random walks for CPU engine test and benchmark
+
+static void RandomWalks(Secp256K1 *secp,int nb,int nbBit,Int *px,Int *py,Int *d) {
+
+  vector<Int> pk;
+  for(int i = 0; i < nb; i++) {
+    d[i].Rand(nbBit);
+    pk.push_back(d[i]);
+  }
+  vector<Point> pts = secp->ComputePublicKeys(pk);
+  for(int i = 0; i < nb; i++) {
+    px[i].Set(&pts[i].x);
+    py[i].Set(&pts[i].y);
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
+double Kangaroo::CPUEngineRate(int type,double duration) {
+
+  CPUEngine cpu(CPU_GRP_SIZE,type,symmetry);
+  int nb = cpu.GetNbKangaroo();
+  Int *px = new Int[nb];
+  Int *py = new Int[nb];
+  Int *d = new Int[nb];
+  vector<ITEM> found;
+
+  // Global generator, also used by the autotune threads
+  LOCK(ghMutex);
+  RandomWalks(secp,nb,rangePower,px,py,d);
+  UNLOCK(ghMutex);
+  Int dmaskInt;
+  HashTable::toInt(&dMask,&dmaskInt);
+  cpu.SetParams(&dmaskInt,jumpDistance,jumpPointx,jumpPointy,rangePower);
+  cpu.SetEscape(&escapeDistance,&escapePointx,&escapePointy);
+  cpu.SetKangaroos(px,py,d);
+
+  uint64_t count = 0;
+  double t0 = Timer::get_tick();
+  double t1 = t0;
+  while(t1 - t0 < duration) {
+    cpu.Launch(found);
+    count += nb;
+    t1 = Timer::get_tick();
+  }
+
+  delete[] px;
+  delete[] py;
+  delete[] d;
+
+  return (double)count / (t1 - t0);
+
+}
+
+// ----------------------------------------------------------------------------
+
+bool Kangaroo::CheckCPUEngine(int type,int nbStep) {
+
+  CPUEngine ref(CPU_GRP_SIZE,CPU_ENGINE_SCALAR,symmetry);
+  CPUEngine cpu(CPU_GRP_SIZE,type,symmetry);
+  int nb = cpu.GetNbKangaroo();
+  Int *px = new Int[nb];
+  Int *py = new Int[nb];
+  Int *d = new Int[nb];
+  Int *rx = new Int[nb];
+  Int *ry = new Int[nb];
+  Int *rd = new Int[nb];
+  vector<ITEM> refFound;
+  vector<ITEM> cpuFound;
+  uint64_t nbDP = 0;
+  bool ok = true;
+
+  RandomWalks(secp,nb,rangePower,px,py,d);
+  Int dmaskInt;
+  HashTable::toInt(&dMask,&dmaskInt);
+  // Reference uses full width distances
+  ref.SetParams(&dmaskInt,jumpDistance,jumpPointx,jumpPointy,256);
+  cpu.SetParams(&dmaskInt,jumpDistance,jumpPointx,jumpPointy,rangePower);
+  ref.SetEscape(&escapeDistance,&escapePointx,&escapePointy);
+  cpu.SetEscape(&escapeDistance,&escapePointx,&escapePointy);
+  ref.SetKangaroos(px,py,d);
+  cpu.SetKangaroos(px,py,d);
+
+  for(int s = 0; ok && s < nbStep; s++) {
+
+    ref.Launch(refFound);
+    cpu.Launch(cpuFound);
+    ok = refFound.size() == cpuFound.size();
+    for(int i = 0; ok && i < (int)refFound.size(); i++) {
+      ok = refFound[i].kIdx == cpuFound[i].kIdx &&
+           refFound[i].x.IsEqual(&cpuFound[i].x) &&
+           refFound[i].d.IsEqual(&cpuFound[i].d);
+    }
+    nbDP += refFound.size();
+    if(!ok) ::printf("CPU engine %s: DP mismatch at step %d\n",CPUEngine::GetName(type),s);
+
+  }
+
+  uint64_t nbEscape = ref.GetNbEscape();
+  ok = ok && nbEscape == cpu.GetNbEscape();
+  ref.GetKangaroos(rx,ry,rd);
+  cpu.GetKangaroos(px,py,d);
+  for(int i = 0; ok && i < nb; i++) {
+    ok = rx[i].IsEqual(&px[i]) && ry[i].IsEqual(&py[i]) && rd[i].IsEqual(&d[i]);
+    if(!ok) ::printf("CPU engine %s: kangaroo #%d mismatch\n",CPUEngine::GetName(type),i);
+  }
+
+  delete[] px;
+  delete[] py;
+  delete[] d;
+  delete[] rx;
+  delete[] ry;
+  delete[] rd;
+
+  double r0 = CPUEngineRate(CPU_ENGINE_SCALAR,1.0);
+  double r1 = CPUEngineRate(type,1.0);
+  ::printf("CPU engine %s%s: %s (%d DP, %d escape) %.3f MK/s (Scalar %.3f MK/s, x%.2f)\n",CPUEngine::GetName(type),
+           symmetry ? " (symmetry)" : "",ok ? "OK" : "Failed",(int)nbDP,(int)nbEscape,r1 / 1000000.0,r0 / 1000000.0,r1 / r0);
+
+  return ok;
+
+}
+
+// ----------------------------------------------------------------------------
+
+bool Kangaroo::CheckHerd(int nb,bool fast) {
+
+  // Starting points against their distance. With symmetry, a wild kangaroo
+  // may be -(d.G + K) stored with -d.
+  bool fs = fastSeed;
+  fastSeed = fast;
+  Int *px = new Int[nb];
+  Int *py = new Int[nb];
+  Int *d = new Int[nb];
+  double t0 = Timer::get_tick();
+  CreateHerd(nb,px,py,d,TAME);
+  double t1 = Timer::get_tick();
+  fastSeed = fs;
+
+  vector<Int> pk;
+  for(int i = 0; i < nb; i++) {
+    Int n(&d[i]);
+    pk.push_back(d[i]);
+    n.ModNegK1order();
+    pk.push_back(n);
+  }
+  vector<Point> S = secp->ComputePublicKeys(pk);
+  vector<Point> Sp;
+  Point Z;
+  Z.Clear();
+  for(int i = 0; i < nb; i++) {
+    Sp.push_back((i % 2 == TAME) ? Z : keyToSearch);
+    Sp.push_back((i % 2 == TAME) ? Z : keyToSearch);
+  }
+  S = secp->AddDirect(Sp,S);
+
+  // Tame distances in the range, and their mean
+  double W = ldexp(1.0,symmetry ? rangePower - 1 : rangePower);
+  double mean = 0.0;
+  bool ok = true;
+  int i = 0;
+  for(; ok && i < nb; i++) {
+    ok = px[i].IsEqual(&S[2 * i].x) || px[i].IsEqual(&S[2 * i + 1].x);
+    if(i % 2 == TAME) {
+      Int t(&d[i]);
+      if(t.GetBitLength() > rangePower) t.ModNegK1order();
+      ok = ok && t.ToDouble() < W;
+      mean += t.ToDouble() / W;
+    }
+  }
+
+  ::printf("Herd seeding %s: %s %.3f KKey/s (tame mean %.3f)\n",fast ? "fast" : "random",
+           ok ? "OK" : "Failed",(double)nb / ((t1 - t0) * 1000.0),mean / (double)(nb / 2));
+  if(!ok)
+    ::printf("Wrong starting point at %d\n",i - 1);
+
+  delete[] px;
+  delete[] py;
+  delete[] d;
+  return ok;
+
+}
+
+// ----------------------------------------------------------------------------
+
+bool Kangaroo::CheckHashTable() {
+
+  // Same x: a duplicate only when the whole distance is equal, otherwise a
+  // collision, also between distances of the same sign (same top word)
+  HashTable *h = new HashTable();
+  Int x;
+  Int d[4];
+  x.Rand(256);
+  d[0].SetInt32(0x1234);
+  d[1].SetInt32(0x5678);
+  d[2].Set(&d[0]);
+  d[2].ModNegK1order();
+  d[3].Set(&d[1]);
+  d[3].ModNegK1order();
+
+  bool ok = true;
+  for(int s = 0; s < 2 && ok; s++) {
+    Int *d1 = &d[2 * s];
+    Int *d2 = &d[2 * s + 1];
+    h->Reset();
+    ok = h->Add(&x,d1,TAME) == ADD_OK &&
+         h->Add(&x,d1,TAME) == ADD_DUPLICATE &&
+         h->Add(&x,d2,WILD) == ADD_COLLISION &&
+         h->kDist.IsEqual(d1) && h->kType == TAME &&
+         h->GetNbItem() == 1;
+  }
+  h->Reset();
+  delete h;
+
+  ::printf("HashTable duplicate/collision: %s\n",ok ? "OK" : "Failed");
+  return ok;
+
+}
+
+// ----------------------------------------------------------------------------
+
 void Kangaroo::Check(std::vector<int> gpuId,std::vector<int> gridSize) {
 
   (void)gpuId;
@@ -458,6 +680,68 @@ void Kangaroo::Check(std::vector<int> gpuId,std::vector<int> gridSize) {
     ::printf("%s\n",pts2[i].toString().c_str());
   }
 
+  // Wide window table (-gtable) against the 8-bit one
+  if(secp->GetTableBit() > 0) {
+    pts2.clear();
+    t0 = Timer::get_tick();
+    for(int j = 0; j < nbKey; j++)
+      pts2.push_back(secp->ComputePublicKeyByte(&priv[j]));
+    t1 = Timer::get_tick();
+    ::printf("ComputePublicKey (8-bit table) %d : %.3f KKey/s\n",nbKey,(double)nbKey / ((t1 - t0)*1000.0));
+    int j = 0;
+    for(; j < nbKey && pts1[j].equals(pts2[j]); j++);
+    if(j < nbKey)
+      ::printf("ComputePublicKey (%d-bit table) wrong at %d\n",secp->GetTableBit(),j);
+    else
+      ::printf("ComputePublicKey (%d-bit table) OK\n",secp->GetTableBit());
+  }
+
+  // Check CPU engines (narrow distance) against the full width scalar one
+  bool sym = symmetry;
+  rangePower = 64;
+  for(int s = 0; s < 2; s++) {
+    symmetry = (s == 1);
+    CreateJumpTable();
+    for(int type = CPU_ENGINE_SCALAR; type <= CPU_ENGINE_IFMA; type++) {
+      if(CPUEngine::IsSupported(type))
+        CheckCPUEngine(type,64);
+      else
+        ::printf("CPU engine %s: not supported\n",CPUEngine::GetName(type));
+    }
+  }
+
+  // Check herd seeding
+  rangeStart.SetBase16("5B3F38AF935A3640D158E871CE6E9666DB862636383386EE0000000000000000");
+  rangeEnd.SetBase16("5B3F38AF935A3640D158E871CE6E9666DB862636383386EEFFFFFFFFFFFFFFFF");
+  Int k1;
+  k1.SetBase16("5B3F38AF935A3640D158E871CE6E9666DB862636383386EE0000000000123000");
+  keysToSearch.clear();
+  keysToSearch.push_back(secp->ComputePublicKey(&k1));
+  keyIdx = 0;
+  InitRange();
+  for(int s = 0; s < 2; s++) {
+    symmetry = (s == 1);
+    InitSearchKey();
+    CheckHerd(16384,false);
+    CheckHerd(16384,true);
+  }
+
+  // Herd creation on all cores
+  uint64_t nbH = 4 * HERD_CHUNK;
+  Int *hx = new Int[nbH];
+  Int *hy = new Int[nbH];
+  Int *hd = new Int[nbH];
+  double hRate = CreateHerds(nbH,hx,hy,hd);
+  ::printf("Herd creation: %d core(s) %.3f MK/s\n",Timer::getCoreNumber(),hRate / 1000000.0);
+  delete[] hx;
+  delete[] hy;
+  delete[] hd;
+
+  CheckHashTable();
+
+  symmetry = sym;
+  CreateJumpTable();
+
   /*
   // Check jump table
   for(int i=0;i<128;i++) {
@@ -22,6 +22,7 @@
 #define RELEASE "2.3"
 
 // Use symmetry
+// Symmetry of the GPU kernel (CPU symmetry is selected at runtime, -sym)
 //#define USE_SYMMETRY
 
 // Number of random jumps
@@ -37,10 +38,39 @@
 // Kangaroo type
 #define TAME 0  // Tame kangaroo
 #define WILD 1  // Wild kangaroo
+#define TAME2 2 // Tame kangaroo, odd start (-method 4)
+#define WILD2 3 // Wild kangaroo from -key (-method 4)
 
 // SendDP Period in sec
 #define SEND_PERIOD 2.0
 
+// Fast herd seeding (-fastseed): kangaroos per chain, step table size
+// (2^FAST_SEED_BIT small multiples) and minimum herd size
+#define FAST_SEED_RUN 64
+#define FAST_SEED_BIT 8
+#define FAST_SEED_MIN 1024
+
+// Cost of a Gaudry-Schost walk restart (-gs), in steps
+#define GS_RESTART_COST 100.0
+
+// Baby-step giant-step: points per batched addition (one inversion),
+// widest range and engine selection (-bsgs/-nobsgs)
+#define BSGS_GRP 1024
+#define BSGS_MAX_BIT 64
+#define BSGS_AUTO 0
+#define BSGS_ON 1
+#define BSGS_OFF 2
+
+// Kangaroos per CreateHerd() call when a herd is created on all cores,
+// below IG_PARALLEL_MIN so that each worker inverts on its own thread
+#define HERD_CHUNK 32768
+
+// Maximum CPU walkers with -ctl (CPU part of the counters)
+#define MAX_CPU_SLOT 128
+
+// Per thread DP staging queue size (power of 2)
+#define DP_QUEUE_SIZE 8192
+
 // Timeout before closing connection idle client in sec
 #define CLIENT_TIMEOUT 3600.0
 
@@ -39,6 +39,32 @@ __global__ void comp_kangaroos(uint64_t *kangaroos,uint32_t maxFound,uint32_t *f
 
 }
 
+// ---------------------------------------------------------------------------------------
+
+// Words written per kangaroo by SetKangaroo(s): x[4], y[4], d[4], lastJump
+#ifdef USE_SYMMETRY
+#define KWORD 13
+#else
+#define KWORD 12
+#endif
+
+// Scatter nb respawned kangaroos, input is packed as kIdx followed by KWORD words
+__global__ void set_kangaroos(uint64_t *kangaroos,uint64_t *input,uint32_t nb,uint32_t nbThreadPerGroup) {
+
+  uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+  if(i >= nb) return;
+
+  uint64_t *in = input + (uint64_t)i * (KWORD + 1);
+  uint64_t kIdx = in[0];
+  uint64_t t = kIdx % nbThreadPerGroup;
+  uint64_t g = (kIdx / nbThreadPerGroup) % GPU_GRP_SIZE;
+  uint64_t b = kIdx / ((uint64_t)nbThreadPerGroup * GPU_GRP_SIZE);
+  uint64_t *k = kangaroos + b * nbThreadPerGroup * GPU_GRP_SIZE * KSIZE + g * nbThreadPerGroup * KSIZE + t;
+  for(int j = 0; j < KWORD; j++)
+    k[j * nbThreadPerGroup] = in[j + 1];
+
+}
+
 // ---------------------------------------------------------------------------------------
 //#define GPU_CHECK
 #ifdef GPU_CHECK
@@ -198,6 +224,9 @@ GPUEngine::GPUEngine(int nbThreadGroup,int nbThreadPerGroup,int gpuId,uint32_t m
   outputItem = NULL;
   outputItemPinned = NULL;
   jumpPinned = NULL;
+  respawnInput = NULL;
+  respawnPinned = NULL;
+  respawnSize = 0;
   dpMask=NULL;
 
   // dpMask
@@ -270,6 +299,8 @@ GPUEngine::~GPUEngine() {
   if(inputKangarooPinned) cudaFreeHost(inputKangarooPinned);
   if(outputItemPinned) cudaFreeHost(outputItemPinned);
   if(jumpPinned) cudaFreeHost(jumpPinned);
+  if(respawnInput) cudaFree(respawnInput);
+  if(respawnPinned) cudaFreeHost(respawnPinned);
 
 }
 
@@ -504,6 +535,59 @@ void GPUEngine::GetKangaroos(Int *px,Int *py,Int *d) {
 
 }
 
+void GPUEngine::SetKangaroos(std::vector<uint64_t> &kIdx,Int *px,Int *py,Int *d) {
+
+  // Respawned kangaroos, one copy and one scatter kernel for the whole batch
+  uint32_t nb = (uint32_t)kIdx.size();
+  if(nb == 0)
+    return;
+
+  uint32_t size = nb * (KWORD + 1) * 8;
+  if(size > respawnSize) {
+    if(respawnInput) cudaFree(respawnInput);
+    if(respawnPinned) cudaFreeHost(respawnPinned);
+    respawnSize = 4096;
+    while(respawnSize < size) respawnSize <<= 1;
+    cudaError_t err = cudaMalloc((void **)&respawnInput,respawnSize);
+    if(err == cudaSuccess)
+      err = cudaHostAlloc(&respawnPinned,respawnSize,cudaHostAllocWriteCombined);
+    if(err != cudaSuccess) {
+      printf("GPUEngine: Allocate respawn memory: %s\n",cudaGetErrorString(err));
+      respawnInput = NULL;
+      respawnPinned = NULL;
+      respawnSize = 0;
+      for(uint32_t i = 0; i < nb; i++)
+        SetKangaroo(kIdx[i],px + i,py + i,d + i);
+      return;
+    }
+  }
+
+  for(uint32_t i = 0; i < nb; i++) {
+    uint64_t *o = respawnPinned + (uint64_t)i * (KWORD + 1);
+    Int dOff;
+    dOff.Set(&d[i]);
+    if(kIdx[i] % 2 == WILD) dOff.ModAddK1order(&wildOffset);
+    o[0] = kIdx[i];
+    for(int j = 0; j < 4; j++) {
+      o[1 + j] = px[i].bits64[j];
+      o[5 + j] = py[i].bits64[j];
+      o[9 + j] = dOff.bits64[j];
+    }
+#ifdef USE_SYMMETRY
+    o[13] = (uint64_t)NB_JUMP;
+#endif
+  }
+
+  cudaMemcpy(respawnInput,respawnPinned,size,cudaMemcpyHostToDevice);
+  set_kangaroos<<<(nb + 127) / 128,128>>>(inputKangaroo,respawnInput,nb,nbThreadPerGroup);
+
+  cudaError_t err = cudaGetLastError();
+  if(err != cudaSuccess) {
+    printf("GPUEngine: SetKangaroos: %s\n",cudaGetErrorString(err));
+  }
+
+}
+
 void GPUEngine::SetKangaroo(uint64_t kIdx,Int *px,Int *py,Int *d) {
 
   int gSize = KSIZE * GPU_GRP_SIZE;
@@ -48,6 +48,7 @@ public:
   void SetKangaroos(Int *px,Int *py,Int *d);
   void GetKangaroos(Int *px,Int *py,Int *d);
   void SetKangaroo(uint64_t kIdx, Int *px,Int *py,Int *d);
+  void SetKangaroos(std::vector<uint64_t> &kIdx,Int *px,Int *py,Int *d);
   bool Launch(std::vector<ITEM> &hashFound,bool spinWait = false);
   void SetWildOffset(Int *offset);
   int GetNbThread();
@@ -73,6 +74,9 @@ private:
   uint32_t *outputItem;
   uint32_t *outputItemPinned;
   uint64_t *jumpPinned;
+  uint64_t *respawnInput;
+  uint64_t *respawnPinned;
+  uint32_t respawnSize;
   bool initialised;
   bool lostWarning;
   uint32_t maxFound;
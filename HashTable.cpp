@@ -24,7 +24,7 @@
 
 #define GET(hash,id) E[hash].items[id]
 
-HashTable::HashTable() {
+HashTable::HashTable() : arena(sizeof(ENTRY)) {
 
   memset(E,0,sizeof(E));
   
@@ -33,14 +33,11 @@ HashTable::HashTable() {
 void HashTable::Reset() {
 
   for(uint32_t h = 0; h < HASH_SIZE; h++) {
-    if(E[h].items) {
-      for(uint32_t i = 0; i<E[h].nbItem; i++)
-        free(E[h].items[i]);
-    }
     safe_free(E[h].items);
     E[h].maxItem = 0;
     E[h].nbItem = 0;
   }
+  arena.Reset();
 
 }
 
@@ -56,7 +53,7 @@ uint64_t HashTable::GetNbItem() {
 
 ENTRY *HashTable::CreateEntry(int256_t *x,int256_t *d, uint32_t kType) {
 
-  ENTRY *e = (ENTRY *)malloc(sizeof(ENTRY));
+  ENTRY *e = (ENTRY *)arena.Alloc();
   e->x.i64[0] = x->i64[0];
   e->x.i64[1] = x->i64[1];
   e->x.i64[2] = x->i64[2];
@@ -230,7 +227,9 @@ int HashTable::Add(Int *x,Int *d,uint32_t type) {
   Convert(x,d,&X,&D);
   uint64_t h = (x->bits64[0] ^ x->bits64[1] ^ x->bits64[2] ^ x->bits64[3]) % HASH_SIZE;
   ENTRY* e = CreateEntry(&X,&D,type);
-  return Add(h,e);
+  int addStatus = Add(h,e);
+  if(addStatus != ADD_OK) arena.Unget(e);
+  return addStatus;
 
 }
 
@@ -245,9 +244,11 @@ void HashTable::ReAllocate(uint64_t h,uint32_t add) {
 }
 
 int HashTable::Add(int256_t *x,int256_t *d, uint32_t type) {
-  uint64_t h = (x->i64[0] ^ x->i64[1] ^ x->i64[2] ^ x->i64[3]) & HASH_SIZE;
+  uint64_t h = (x->i64[0] ^ x->i64[1] ^ x->i64[2] ^ x->i64[3]) % HASH_SIZE;
   ENTRY *e = CreateEntry(x,d,type);
-  return Add(h,e);
+  int addStatus = Add(h,e);
+  if(addStatus != ADD_OK) arena.Unget(e);
+  return addStatus;
 
 }
 
@@ -291,8 +292,8 @@ int HashTable::Add(uint64_t h,ENTRY* e) {
       uint64_t d21 = ent->d.i64[1];
       uint64_t d22 = ent->d.i64[2];
       uint64_t d23 = ent->d.i64[3];
-      if ((d10 == d20 && d11 == d21 && d12 == d22) || d13 == d23) {
-	// Same point added twice or collision in the same herd!
+      if(d10 == d20 && d11 == d21 && d12 == d22 && d13 == d23) {
+	// Same point added twice
 	return ADD_DUPLICATE;
       }
       // Collision
@@ -463,7 +464,7 @@ void HashTable::LoadTable(FILE* f,uint32_t from,uint32_t to) {
       E[h].items = (ENTRY**)malloc(sizeof(ENTRY*) * E[h].maxItem);
 
     for(uint32_t i = 0; i < E[h].nbItem; i++) {
-      ENTRY* e = (ENTRY*)malloc(sizeof(ENTRY));
+      ENTRY* e = (ENTRY*)arena.Alloc();
       fread(&(e->x),32,1,f);
       fread(&(e->d),32,1,f);
       fread(&(e->kType),4,1,f);
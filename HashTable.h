@@ -22,6 +22,7 @@
 #include <vector>
 #include "SECPK1/Point.h"
 #include "Constants.h"
+#include "HugePage.h"
 #ifdef WIN64
 #include <Windows.h>
 #endif
@@ -82,6 +83,7 @@ public:
   void SeekNbItem(FILE* f,uint32_t from,uint32_t to);
 
   HASH_ENTRY    E[HASH_SIZE];
+  HugeArena     arena;   // Entry storage, released by Reset()
   // Collision info
   Int      kDist;
   uint32_t kType;
@@ -0,0 +1,269 @@
+/*
+ * This file is part of the BSGS distribution (https://github.com/JeanLucPons/Kangaroo).
+ * Copyright (c) 2020 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HugePage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include <atomic>
+#ifndef WIN64
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+typedef struct {
+  uintptr_t start;
+  size_t size;
+  bool hugetlb;   // Explicit huge pages
+} HUGE_REGION;
+
+// Flags shared by concurrent Alloc() calls
+static std::atomic<bool> hugeEnabled(true);
+static std::atomic<bool> hugetlbFailed(false);
+static std::mutex regionMutex;
+static vector<HUGE_REGION> regions;
+static uint64_t smallSize = 0;
+
+// ----------------------------------------------------------------------------
+
+void HugePage::SetEnabled(bool enabled) {
+  hugeEnabled = enabled;
+}
+
+// ----------------------------------------------------------------------------
+
+void *HugePage::Alloc(size_t size) {
+
+#ifndef WIN64
+
+  if(hugeEnabled && size >= HUGE_PAGE_MIN) {
+
+    size_t hSize = ((size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE;
+    void *p = MAP_FAILED;
+    bool hugetlb = false;
+
+#ifdef MAP_HUGETLB
+    // Explicit pool, not tried again once exhausted
+    if(!hugetlbFailed) {
+      p = mmap(NULL,hSize,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,-1,0);
+      hugetlb = (p != MAP_FAILED);
+      if(!hugetlb) hugetlbFailed = true;
+    }
+#endif
+
+    if(p == MAP_FAILED) {
+      // Transparent huge pages, the mapping is aligned on a huge page
+      uint8_t *m = (uint8_t *)mmap(NULL,hSize + HUGE_PAGE_SIZE,PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+      if(m != (uint8_t *)MAP_FAILED) {
+        uint8_t *a = (uint8_t *)((((uintptr_t)m + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE);
+        if(a > m) munmap(m,a - m);
+        munmap(a + hSize,(m + hSize + HUGE_PAGE_SIZE) - (a + hSize));
+#ifdef MADV_HUGEPAGE
+        madvise(a,hSize,MADV_HUGEPAGE);
+#endif
+        p = a;
+      }
+    }
+
+    if(p != MAP_FAILED) {
+      HUGE_REGION r;
+      r.start = (uintptr_t)p;
+      r.size = hSize;
+      r.hugetlb = hugetlb;
+      regionMutex.lock();
+      regions.push_back(r);
+      regionMutex.unlock();
+      return p;
+    }
+
+  }
+
+#endif
+
+  // Fallback
+  void *p = NULL;
+#ifdef WIN64
+  p = _aligned_malloc(size,64);
+#else
+  if(posix_memalign(&p,64,size) != 0) p = NULL;
+#endif
+  if(p == NULL) {
+    ::printf("HugePage::Alloc: cannot allocate %.1f MB\n",(double)size / (1024.0 * 1024.0));
+    exit(-1);
+  }
+  memset(p,0,size);
+  regionMutex.lock();
+  smallSize += size;
+  regionMutex.unlock();
+  return p;
+
+}
+
+// ----------------------------------------------------------------------------
+
+void HugePage::Free(void *p,size_t size) {
+
+  if(p == NULL)
+    return;
+
+  regionMutex.lock();
+  for(int i = 0; i < (int)regions.size(); i++) {
+    if(regions[i].start == (uintptr_t)p) {
+      size_t hSize = regions[i].size;
+      regions.erase(regions.begin() + i);
+      regionMutex.unlock();
+#ifndef WIN64
+      munmap(p,hSize);
+#endif
+      return;
+    }
+  }
+  smallSize -= size;
+  regionMutex.unlock();
+
+#ifdef WIN64
+  _aligned_free(p);
+#else
+  free(p);
+#endif
+
+}
+
+// ----------------------------------------------------------------------------
+
+void HugePage::GetCoverage(uint64_t *total,uint64_t *huge) {
+
+  regionMutex.lock();
+  vector<HUGE_REGION> r = regions;
+  *total = smallSize;
+  regionMutex.unlock();
+
+  *huge = 0;
+  for(int i = 0; i < (int)r.size(); i++) {
+    *total += r[i].size;
+    if(r[i].hugetlb) *huge += r[i].size;
+  }
+
+#ifndef WIN64
+
+  // Transparent huge pages in use: AnonHugePages of the mappings that
+  // overlap a region, in proportion to the overlap (adjacent regions may
+  // be merged in a single mapping)
+  FILE *f = fopen("/proc/self/smaps","r");
+  if(f == NULL)
+    return;
+
+  char line[512];
+  uintptr_t vStart = 0;
+  uintptr_t vEnd = 0;
+  uint64_t overlap = 0;
+  while(fgets(line,sizeof(line),f)) {
+    unsigned long s,e;
+    unsigned long kb;
+    if(sscanf(line,"%lx-%lx ",&s,&e) == 2 && strchr(line,'-') < strchr(line,' ')) {
+      vStart = (uintptr_t)s;
+      vEnd = (uintptr_t)e;
+      overlap = 0;
+      for(int i = 0; i < (int)r.size(); i++) {
+        if(r[i].hugetlb) continue;
+        uintptr_t a = (r[i].start > vStart) ? r[i].start : vStart;
+        uintptr_t b = (r[i].start + r[i].size < vEnd) ? r[i].start + r[i].size : vEnd;
+        if(b > a) overlap += b - a;
+      }
+    } else if(overlap > 0 && sscanf(line,"AnonHugePages: %lu kB",&kb) == 1) {
+      double ratio = (double)overlap / (double)(vEnd - vStart);
+      *huge += (uint64_t)((double)kb * 1024.0 * ratio);
+    }
+  }
+  fclose(f);
+
+#endif
+
+}
+
+// ----------------------------------------------------------------------------
+
+void HugePage::PrintCoverage(const char *prefix) {
+
+  uint64_t total;
+  uint64_t huge;
+  GetCoverage(&total,&huge);
+  if(total == 0)
+    return;
+  ::printf("%sHuge pages: %.1fMB of %.1fMB (%.1f%%)%s\n",prefix,(double)huge / (1024.0 * 1024.0),
+           (double)total / (1024.0 * 1024.0),100.0 * (double)huge / (double)total,
+           hugeEnabled ? "" : " [disabled]");
+
+}
+
+// ----------------------------------------------------------------------------
+
+HugeArena::HugeArena(size_t itemSize) {
+
+  // 8 bytes aligned items
+  this->itemSize = (itemSize + 7) & ~(size_t)7;
+  chunkSize = 0;
+  pos = 0;
+
+}
+
+HugeArena::~HugeArena() {
+  Reset();
+}
+
+// ----------------------------------------------------------------------------
+
+void *HugeArena::Alloc() {
+
+  if(chunks.size() == 0 || pos + itemSize > chunkSize) {
+    chunkSize = (chunkSize == 0) ? ARENA_CHUNK_MIN : chunkSize * 2;
+    if(chunkSize > ARENA_CHUNK_MAX) chunkSize = ARENA_CHUNK_MAX;
+    chunks.push_back((uint8_t *)HugePage::Alloc(chunkSize));
+    sizes.push_back(chunkSize);
+    pos = 0;
+  }
+
+  void *p = chunks.back() + pos;
+  pos += itemSize;
+  return p;
+
+}
+
+// ----------------------------------------------------------------------------
+
+void HugeArena::Unget(void *p) {
+
+  if(chunks.size() > 0 && pos >= itemSize && (uint8_t *)p == chunks.back() + pos - itemSize)
+    pos -= itemSize;
+
+}
+
+// ----------------------------------------------------------------------------
+
+void HugeArena::Reset() {
+
+  for(int i = 0; i < (int)chunks.size(); i++)
+    HugePage::Free(chunks[i],sizes[i]);
+  chunks.clear();
+  sizes.clear();
+  chunkSize = 0;
+  pos = 0;
+
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is part of the BSGS distribution (https://github.com/JeanLucPons/Kangaroo).
+ * Copyright (c) 2020 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HUGEPAGEH
+#define HUGEPAGEH
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Huge page size (x86-64 2MB pages)
+#define HUGE_PAGE_SIZE (2ULL * 1024 * 1024)
+
+// Smaller blocks are allocated with malloc
+#define HUGE_PAGE_MIN (HUGE_PAGE_SIZE / 2)
+
+// Arena chunk size bounds, chunks double from min to max
+#define ARENA_CHUNK_MIN HUGE_PAGE_SIZE
+#define ARENA_CHUNK_MAX (256ULL * 1024 * 1024)
+
+// Large blocks backed by huge pages: explicit ones (MAP_HUGETLB) when the
+// system has a pool, else transparent ones (madvise). Blocks are zeroed
+// and 64 bytes aligned. Falls back to malloc when huge pages are not
+// available or disabled.
+class HugePage {
+
+public:
+
+  static void *Alloc(size_t size);
+  static void Free(void *p,size_t size);
+  static void SetEnabled(bool enabled);
+
+  // Allocated bytes and bytes actually on huge pages (from smaps)
+  static void GetCoverage(uint64_t *total,uint64_t *huge);
+  static void PrintCoverage(const char *prefix);
+
+};
+
+// Bump allocator of fixed size items in huge page chunks, released at
+// once by Reset() (no per item free). Not thread safe.
+class HugeArena {
+
+public:
+
+  HugeArena(size_t itemSize);
+  ~HugeArena();
+
+  void *Alloc();
+  void Unget(void *p);  // Release p if it is the last allocated item
+  void Reset();
+
+private:
+
+  size_t itemSize;
+  size_t chunkSize;
+  size_t pos;
+  std::vector<uint8_t *> chunks;
+  std::vector<size_t> sizes;
+
+};
+
+#endif // HUGEPAGEH
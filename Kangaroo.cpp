@@ -34,7 +34,10 @@ using namespace std;
 // ----------------------------------------------------------------------------
 
 Kangaroo::Kangaroo(Secp256K1 *secp,int32_t initDPSize,bool useGpu,string &workFile,string &iWorkFile,uint32_t savePeriod,bool saveKangaroo,bool saveKangarooByServer,
-                   double maxStep,int wtimeout,int port,int ntimeout,string serverIp,string outputFile,bool splitWorkfile,string &workTextFile,bool saveKangarooText) {
+                   double maxStep,int wtimeout,int port,int ntimeout,string serverIp,string outputFile,bool splitWorkfile,string &workTextFile,bool saveKangarooText,
+                   int cpuEngine,bool affinity,bool symmetry,bool autoTune,double ramBudget,bool fastSeed,
+                   bool profile,string ctlFile,bool multiKey,string tameDBFile,uint64_t tameDBBuild,
+                   int method,bool gaudrySchost,int bsgsMode) {
 
   this->secp = secp;
   this->initDPSize = initDPSize;
@@ -99,6 +102,30 @@ Kangaroo::Kangaroo(Secp256K1 *secp,int32_t initDPSize,bool useGpu,string &workFi
   this->splitWorkfile = splitWorkfile;
   this->pid = Timer::getPID();
   this->asyncSaveRunning = false;
+  this->cpuEngine = (cpuEngine == CPU_ENGINE_AUTO) ? CPUEngine::GetBestType() : cpuEngine;
+  this->cpuScalarRate = 0.0;
+  this->affinity = affinity;
+  this->symmetry = symmetry;
+  this->method = method;
+  this->gaudrySchost = gaudrySchost;
+  this->bsgsMode = bsgsMode;
+  this->nbNode = 1;
+  this->autoTune = autoTune;
+  this->fastSeed = fastSeed;
+  this->profile = profile;
+  this->ctlFile = ctlFile;
+  this->nbCPUActive = 0;
+  this->walkerHandles = NULL;
+  this->multiKey = multiKey;
+  this->mkSlotKey = NULL;
+  this->mkEpoch = 0;
+  this->mkNbSolved = 0;
+  this->tameDBFile = tameDBFile;
+  this->tameDBBuild = tameDBBuild;
+  this->tameDB = NULL;
+  this->ramBudget = ramBudget;
+  this->tuneRate = 0.0;
+  this->tuneDPRate = 0.0;
 
   CPU_GRP_SIZE = 1024;
 
@@ -156,17 +183,33 @@ bool Kangaroo::ParseConfigFile(std::string &fileName) {
 
   rangeStart.SetBase16((char *)lines[0].c_str());
   rangeEnd.SetBase16((char *)lines[1].c_str());
+  bool hasStart = false;
   for(int i=2;i<(int)lines.size();i++) {
     
+    // Key, optionally followed by its own range start (same width)
+    string key = lines[i];
+    Int start(&rangeStart);
+    size_t sp = key.find_first_of(" \t");
+    if(sp != string::npos) {
+      string s = key.substr(sp);
+      key = key.substr(0,sp);
+      s.erase(0,s.find_first_not_of(" \t"));
+      start.SetBase16((char *)s.c_str());
+      hasStart = true;
+    }
+
     Point p;
     bool isCompressed;
-    if( !secp->ParsePublicKeyHex(lines[i],p,isCompressed) ) {
+    if( !secp->ParsePublicKeyHex(key,p,isCompressed) ) {
       ::printf("%s, error line %d: %s\n",fileName.c_str(),i,lines[i].c_str());
       return false;
     }
     keysToSearch.push_back(p);
+    keyStart.push_back(start);
 
   }
+  if(!hasStart)
+    keyStart.clear();
 
   ::printf("Start:%s\n",rangeStart.GetBase16().c_str());
   ::printf("Stop :%s\n",rangeEnd.GetBase16().c_str());
@@ -272,9 +315,8 @@ bool  Kangaroo::CheckKey(Int d1,Int d2,uint8_t type) {
 
   if(P.equals(keyToSearch)) {
     // Key solved    
-#ifdef USE_SYMMETRY
-    pk.ModAddK1order(&rangeWidthDiv2);
-#endif
+    if(symmetry || method == 4)
+      pk.ModAddK1order(&rangeWidthDiv2);
     pk.ModAddK1order(&rangeStart);    
     return Output(&pk,'N',type);
   }
@@ -282,9 +324,8 @@ bool  Kangaroo::CheckKey(Int d1,Int d2,uint8_t type) {
   if(P.equals(keyToSearchNeg)) {
     // Key solved
     pk.ModNegK1order();
-#ifdef USE_SYMMETRY
-    pk.ModAddK1order(&rangeWidthDiv2);
-#endif
+    if(symmetry || method == 4)
+      pk.ModAddK1order(&rangeWidthDiv2);
     pk.ModAddK1order(&rangeStart);
     return Output(&pk,'S',type);
   }
@@ -293,10 +334,46 @@ bool  Kangaroo::CheckKey(Int d1,Int d2,uint8_t type) {
 
 }
 
+bool Kangaroo::CheckKeyHalf(Int d1,Int d2) {
+
+  // Wild from key (d1) on a wild from -key (d2): key + d1 = -key + d2
+  Int inv2(&secp->order);
+  inv2.AddOne();
+  inv2.ShiftR(1);
+  Int pk(&d2);
+  pk.ModSubK1order(&d1);
+  pk.ModMulK1order(&inv2);
+
+  Point P = secp->ComputePublicKey(&pk);
+
+  if(P.equals(keyToSearch)) {
+    pk.ModAddK1order(&rangeWidthDiv2);
+    pk.ModAddK1order(&rangeStart);
+    return Output(&pk,'N',4);
+  }
+
+  if(P.equals(keyToSearchNeg)) {
+    pk.ModNegK1order();
+    pk.ModAddK1order(&rangeWidthDiv2);
+    pk.ModAddK1order(&rangeStart);
+    return Output(&pk,'S',4);
+  }
+
+  return false;
+
+}
+
 bool Kangaroo::CollisionCheck(Int* d1,uint32_t type1,Int* d2,uint32_t type2) {
 
 
-  if(type1 == type2) {
+  // Wild from key on a wild from -key (-method 4)
+  if(method == 4 && ((type1 == WILD && type2 == WILD2) || (type1 == WILD2 && type2 == WILD))) {
+    endOfSearch = (type1 == WILD) ? CheckKeyHalf(*d1,*d2) : CheckKeyHalf(*d2,*d1);
+    return endOfSearch;
+  }
+
+  // Bit 0 is the herd, multi-key wild types also carry their key
+  if((type1 & 1) == (type2 & 1)) {
 
     // Collision inside the same herd
     return false;
@@ -306,7 +383,7 @@ bool Kangaroo::CollisionCheck(Int* d1,uint32_t type1,Int* d2,uint32_t type2) {
     Int Td;
     Int Wd;
 
-    if(type1 == TAME) {
+    if((type1 & 1) == TAME) {
       Td.Set(d1);
       Wd.Set(d2);
     }  else {
@@ -314,6 +391,9 @@ bool Kangaroo::CollisionCheck(Int* d1,uint32_t type1,Int* d2,uint32_t type2) {
       Wd.Set(d1);
     }
 
+    if(multiKey)
+      return CheckMultiKey(&Td,&Wd,((type1 & 1) == TAME) ? type2 : type1);
+
     endOfSearch = CheckKey(Td,Wd,0) || CheckKey(Td,Wd,1) || CheckKey(Td,Wd,2) || CheckKey(Td,Wd,3);
     // TODO we can literally attack any point around Td+Wd, but which???
     if(!endOfSearch) {
@@ -346,15 +426,88 @@ bool Kangaroo::CollisionCheck(Int* d1,uint32_t type1,Int* d2,uint32_t type2) {
 
 // ----------------------------------------------------------------------------
 
+bool Kangaroo::CheckMultiKey(Int *Td,Int *Wd,uint32_t wType) {
+
+  // One point per equivalence, matched against the unsolved keys starting
+  // with the key of the wild kangaroo (the DP may come from a wild that has
+  // been respawned for another key since)
+  int nbKey = (int)keysToSearch.size();
+  int k0 = (int)(wType >> 1);
+
+  for(int type = 0; type < 4; type++) {
+
+    Int d1(Td);
+    Int d2(Wd);
+    if(type & 0x1)
+      d1.ModNegK1order();
+    if(type & 0x2)
+      d2.ModNegK1order();
+    Int pk(&d1);
+    pk.ModAddK1order(&d2);
+    Point P = secp->ComputePublicKey(&pk);
+
+    for(int i = 0; i < nbKey; i++) {
+
+      int k = (k0 + i) % nbKey;
+      if(mkSolved[k] || !P.x.IsEqual(&mkKey[k].x))
+        continue;
+      SelectKey(k);
+      if(!CheckKey(*Td,*Wd,(uint8_t)type))
+        continue;
+
+      // Wild slots of this key move to the remaining keys
+      mkSolved[k] = true;
+      mkNbSolved++;
+      if(mkNbSolved == nbKey) {
+        endOfSearch = true;
+        return true;
+      }
+      vector<int> left;
+      for(int j = 0; j < nbKey; j++)
+        if(!mkSolved[j]) left.push_back(j);
+      int r = 0;
+      for(int s = 0; s < nbKey; s++)
+        if(mkSolved[mkSlotKey[s]])
+          mkSlotKey[s] = left[(r++) % left.size()];
+      mkEpoch++;
+      return true;
+
+    }
+
+  }
+
+  return false;
+
+}
+
+// ----------------------------------------------------------------------------
+
+bool Kangaroo::CheckTameDB(int256_t *x,Int *dist,uint32_t kType) {
+
+  // Wild DP against the precomputed tame DP
+  Int tDist;
+  if(!tameDB->Find(x,&tDist))
+    return false;
+  return CollisionCheck(&tDist,TAME,dist,kType);
+
+}
+
 bool Kangaroo::AddToTable(Int *pos,Int *dist,uint32_t kType) {
 
+  if(tameDB) {
+    int256_t x;
+    HashTable::toint256t(pos,&x);
+    if(CheckTameDB(&x,dist,kType))
+      return true;
+  }
+
   int addStatus = hashTable.Add(pos,dist,kType);
   if(addStatus== ADD_COLLISION)
     return CollisionCheck(&hashTable.kDist,hashTable.kType,dist,kType);
 
   // Track tame/wild DP counts
   if(addStatus == ADD_OK) {
-    if(kType == 0) {
+    if((kType & 1) == TAME) {
       tameCount++;
     } else {
       wildCount++;
@@ -367,6 +520,14 @@ bool Kangaroo::AddToTable(Int *pos,Int *dist,uint32_t kType) {
 
 bool Kangaroo::AddToTable(int256_t *x,int256_t *d, uint32_t kType) {
 
+  if(tameDB) {
+    Int dist;
+    dist.SetInt32(0);
+    HashTable::toInt(d,&dist);
+    if(CheckTameDB(x,&dist,kType))
+      return true;
+  }
+
   int addStatus = hashTable.Add(x,d,kType);
   if(addStatus== ADD_COLLISION) {
 
@@ -378,7 +539,7 @@ bool Kangaroo::AddToTable(int256_t *x,int256_t *d, uint32_t kType) {
 
   // Track tame/wild DP counts
   if(addStatus == ADD_OK) {
-    if(kType == 0) {
+    if((kType & 1) == TAME) {
       tameCount++;
     } else {
       wildCount++;
@@ -394,116 +555,81 @@ bool Kangaroo::AddToTable(int256_t *x,int256_t *d, uint32_t kType) {
 void Kangaroo::SolveKeyCPU(TH_PARAM *ph) {
 
   vector<ITEM> dps;
+  vector<ITEM> cpuFound;
+  vector<uint64_t> dead;
+  vector<Int> rPx;
+  vector<Int> rPy;
+  vector<Int> rD;
   double lastSent = 0;
 
   // Global init
   int thId = ph->threadId;
 
-  // Create Kangaroos
-  ph->nbKangaroo = CPU_GRP_SIZE;
+  // Pin before any allocation, the herd is first touched on the local node
+  if(ph->cpuId >= 0 && !CPUTopology::Pin(ph->cpuId))
+    ::printf("SolveKeyCPU Thread %d: cannot pin to cpu %d\n",ph->threadId,ph->cpuId);
 
-#ifdef USE_SYMMETRY
-  ph->symClass = new uint64_t[CPU_GRP_SIZE];
-  for(int i = 0; i<CPU_GRP_SIZE; i++) ph->symClass[i] = 0;
-#endif
+  CPUEngine *cpu = new CPUEngine(CPU_GRP_SIZE,cpuEngine,symmetry);
 
-  IntGroup *grp = new IntGroup(CPU_GRP_SIZE);
-  Int *dx = new Int[CPU_GRP_SIZE];
+  // Create Kangaroos
+  ph->nbKangaroo = cpu->GetNbKangaroo();
 
   if(ph->px==NULL) {
 
     // Create Kangaroos, if not already loaded
-    ph->px = new Int[CPU_GRP_SIZE];
-    ph->py = new Int[CPU_GRP_SIZE];
-    ph->distance = new Int[CPU_GRP_SIZE];
-    CreateHerd(CPU_GRP_SIZE,ph->px,ph->py,ph->distance,TAME);
+    ph->px = new Int[ph->nbKangaroo];
+    ph->py = new Int[ph->nbKangaroo];
+    ph->distance = new Int[ph->nbKangaroo];
+    double t = Timer::get_tick();
+    CreateHerd((int)ph->nbKangaroo,ph->px,ph->py,ph->distance,TAME,NULL,ph->threadId);
+    t = Timer::get_tick() - t;
+    ph->createRate = (t > 0.0) ? (double)ph->nbKangaroo / t : 0.0;
 
   }
 
-  if(keyIdx==0)
-    ::printf("SolveKeyCPU Thread %d: %d kangaroos\n",ph->threadId,CPU_GRP_SIZE);
+  Int dmaskInt;
+  HashTable::toInt(&dMask,&dmaskInt);
+  cpu->SetParams(&dmaskInt,jumpDistance,jumpPointx,jumpPointy,rangePower);
+  cpu->SetEscape(&escapeDistance,&escapePointx,&escapePointy);
+  cpu->SetKangaroos(ph->px,ph->py,ph->distance);
+
+  ph->nbEscape = 0;
+  cpu->GetWalkStats(ph->dpHist,&ph->nbStuck);
+
+  CPUProfile *prof = ph->prof;
+  if(prof) {
+    prof->Open();
+    cpu->SetProfile(prof);
+  }
 
-  ph->hasStarted = true;
+  if(keyIdx==0 && !ph->hasStarted) {
+    if(ph->createRate > 0.0)
+      ::printf("SolveKeyCPU Thread %d: %d kangaroos [%.2f MK/s]\n",ph->threadId,(int)ph->nbKangaroo,
+               ph->createRate / 1000000.0);
+    else
+      ::printf("SolveKeyCPU Thread %d: %d kangaroos\n",ph->threadId,(int)ph->nbKangaroo);
+  }
 
-  // Using Affine coord
-  Int dy;
-  Int rx;
-  Int ry;
-  Int _s;
-  Int _p;
+  ph->hasStarted = true;
 
-  while(!endOfSearch) {
+  while(!endOfSearch && !ph->stopRequest) {
 
     // Random walk
-
-    for(int g = 0; g < CPU_GRP_SIZE; g++) {
-
-#ifdef USE_SYMMETRY
-      uint64_t jmp = ph->px[g].bits64[0] % (NB_JUMP/2) + (NB_JUMP / 2) * ph->symClass[g];
-#else
-      uint64_t jmp = ph->px[g].bits64[0] % NB_JUMP;
-#endif
-
-      Int *p1x = &jumpPointx[jmp];
-      Int *p2x = &ph->px[g];
-      dx[g].ModSub(p2x,p1x);
-
-    }
-
-    grp->Set(dx);
-    grp->ModInv();
-
-    for(int g = 0; g < CPU_GRP_SIZE; g++) {
-
-#ifdef USE_SYMMETRY
-      uint64_t jmp = ph->px[g].bits64[0] % (NB_JUMP / 2) + (NB_JUMP / 2) * ph->symClass[g];
-#else
-      uint64_t jmp = ph->px[g].bits64[0] % NB_JUMP;
-#endif
-
-      Int *p1x = &jumpPointx[jmp];
-      Int *p1y = &jumpPointy[jmp];
-      Int *p2x = &ph->px[g];
-      Int *p2y = &ph->py[g];
-
-      dy.ModSub(p2y,p1y);
-      _s.ModMulK1(&dy,&dx[g]);
-      _p.ModSquareK1(&_s);
-
-      rx.ModSub(&_p,p1x);
-      rx.ModSub(p2x);
-
-      ry.ModSub(p2x,&rx);
-      ry.ModMulK1(&_s);
-      ry.ModSub(p2y);
-
-      ph->distance[g].ModAddK1order(&jumpDistance[jmp]);
-
-#ifdef USE_SYMMETRY
-      // Equivalence symmetry class switch
-      if( ry.ModPositiveK1() ) {
-        ph->distance[g].ModNegK1order();
-        ph->symClass[g] = !ph->symClass[g];
-      }
-#endif
-
-      ph->px[g].Set(&rx);
-      ph->py[g].Set(&ry);
-
+    if(prof) prof->StartSample();
+    cpu->Launch(cpuFound);
+    uint64_t pTick = prof ? prof->Begin() : 0;
+
+    // Gaudry-Schost, a walk ends at its DP and restarts at a random point
+    if(gaudrySchost) {
+      for(int i = 0; i < (int)cpuFound.size(); i++)
+        dead.push_back(cpuFound[i].kIdx);
     }
 
     if( clientMode ) {
 
       // Send DP to server
-      for(int g = 0; g < CPU_GRP_SIZE; g++) {
-        if(IsDP(&ph->px[g])) {
-          ITEM it;
-          it.x.Set(&ph->px[g]);
-          it.d.Set(&ph->distance[g]);
-          it.kIdx = g;
-          dps.push_back(it);
-        }
-      }
+      for(int i = 0; i < (int)cpuFound.size(); i++)
+        dps.push_back(cpuFound[i]);
 
       double now = Timer::get_tick();
       if( now-lastSent > SEND_PERIOD ) {
@@ -512,54 +638,62 @@ void Kangaroo::SolveKeyCPU(TH_PARAM *ph) {
         UNLOCK(ghMutex);
         lastSent = now;
       }
-
-      if(!endOfSearch) counters[thId] += CPU_GRP_SIZE;
+      if(pTick) prof->Mark(PROF_SEND,&pTick);
 
     } else {
 
-      // Add to table and collision check
-      for(int g = 0; g < CPU_GRP_SIZE && !endOfSearch; g++) {
-
-        if(IsDP(&ph->px[g])) {
-          LOCK(ghMutex);
-          if(!endOfSearch) {
+      // Stage DP, added to table by the flush thread
+      PushDP(ph,cpuFound);
 
-            if(!AddToTable(&ph->px[g],&ph->distance[g],g % 2)) {
-              // Collision inside the same herd
-              // We need to reset the kangaroo
-              CreateHerd(1,&ph->px[g],&ph->py[g],&ph->distance[g],g % 2,false);
-              collisionInSameHerd++;
-            }
+      // Collision inside the same herd
+      uint64_t kIdx;
+      while(ph->deadQueue->Pop(&kIdx))
+        dead.push_back(kIdx);
 
-          }
-          UNLOCK(ghMutex);
-        }
+      // Wild kangaroos of a solved key
+      if(multiKey)
+        ResyncMultiKey(ph,dead);
 
-        if(!endOfSearch) counters[thId] ++;
-
-      }
+    }
 
+    // Dead and stuck kangaroos, respawned in one batch
+    cpu->GetStuck(dead);
+    if(dead.size() > 0) {
+      RespawnKangaroos(ph->threadId,dead,rPx,rPy,rD);
+      cpu->SetKangaroos(dead,rPx.data(),rPy.data(),rD.data());
+      dead.clear();
     }
 
+    if(!endOfSearch) counters[thId].count += ph->nbKangaroo;
+    ph->nbEscape = cpu->GetNbEscape();
+    cpu->GetWalkStats(ph->dpHist,&ph->nbStuck);
+    if(pTick) prof->Mark(PROF_STAGE,&pTick);
+
     // Save request
     if(saveRequest && !endOfSearch) {
+      cpu->GetKangaroos(ph->px,ph->py,ph->distance);
       ph->isWaiting = true;
       LOCK(saveMutex);
       ph->isWaiting = false;
       UNLOCK(saveMutex);
+      if(pTick) prof->Mark(PROF_WAIT,&pTick);
     }
 
+    if(prof) prof->EndSample(ph->nbKangaroo);
+
   }
 
-  // Free
-  delete grp;
-  delete[] dx;
-  safe_delete_array(ph->px);
-  safe_delete_array(ph->py);
-  safe_delete_array(ph->distance);
-#ifdef USE_SYMMETRY
-  safe_delete_array(ph->symClass);
-#endif
+  if(ph->stopRequest && !endOfSearch) {
+    // Parked, the herd is kept for the next worker of this slot
+    cpu->GetKangaroos(ph->px,ph->py,ph->distance);
+    delete cpu;
+  } else {
+    // Free
+    delete cpu;
+    safe_delete_array(ph->px);
+    safe_delete_array(ph->py);
+    safe_delete_array(ph->distance);
+  }
 
   ph->isRunning = false;
 
@@ -578,6 +712,10 @@ void Kangaroo::SolveKeyGPU(TH_PARAM *ph) {
 
   vector<ITEM> dps;
   vector<ITEM> gpuFound;
+  vector<uint64_t> dead;
+  vector<Int> rPx;
+  vector<Int> rPy;
+  vector<Int> rD;
   GPUEngine *gpu;
 
   gpu = new GPUEngine(ph->gridSizeX,ph->gridSizeY,ph->gpuId,65536 * 2);
@@ -597,19 +735,16 @@ void Kangaroo::SolveKeyGPU(TH_PARAM *ph) {
     ph->py = new Int[ph->nbKangaroo];
     ph->distance = new Int[ph->nbKangaroo];
 
-    for(uint64_t i = 0; i<nbThread; i++) {
-      CreateHerd(GPU_GRP_SIZE,&(ph->px[i*GPU_GRP_SIZE]),
-                              &(ph->py[i*GPU_GRP_SIZE]),
-                              &(ph->distance[i*GPU_GRP_SIZE]),
-                              TAME);
-    }
+    double rate = CreateHerds(nbThread * GPU_GRP_SIZE,ph->px,ph->py,ph->distance);
+    if(keyIdx == 0)
+      ::printf("SolveKeyGPU Thread GPU#%d: %.0f kangaroos created [%.2f MK/s]\n",ph->gpuId,
+               (double)(nbThread * GPU_GRP_SIZE),rate / 1000000.0);
   }
 
-#ifdef USE_SYMMETRY
-  gpu->SetWildOffset(&rangeWidthDiv4);
-#else
-  gpu->SetWildOffset(&rangeWidthDiv2);
-#endif
+  if(symmetry)
+    gpu->SetWildOffset(&rangeWidthDiv4);
+  else
+    gpu->SetWildOffset(&rangeWidthDiv2);
   Int dmaskInt;
   HashTable::toInt(&dMask, &dmaskInt);
   gpu->SetParams(&dmaskInt,jumpDistance,jumpPointx,jumpPointy);
@@ -634,7 +769,7 @@ void Kangaroo::SolveKeyGPU(TH_PARAM *ph) {
   while(!endOfSearch) {
 
     gpu->Launch(gpuFound);
-    counters[thId] += ph->nbKangaroo * NB_RUN;
+    counters[thId].count += ph->nbKangaroo * NB_RUN;
 
     if( clientMode ) {
 
@@ -651,27 +786,17 @@ void Kangaroo::SolveKeyGPU(TH_PARAM *ph) {
 
     } else {
 
-      if(gpuFound.size() > 0) {
-
-        LOCK(ghMutex);
-
-        for(int g = 0; !endOfSearch && g < gpuFound.size(); g++) {
-
-          uint32_t kType = (uint32_t)(gpuFound[g].kIdx % 2);
-
-          if(!AddToTable(&gpuFound[g].x,&gpuFound[g].d,kType)) {
-            // Collision inside the same herd
-            // We need to reset the kangaroo
-            Int px;
-            Int py;
-            Int d;
-            CreateHerd(1,&px,&py,&d,kType,false);
-            gpu->SetKangaroo(gpuFound[g].kIdx,&px,&py,&d);
-            collisionInSameHerd++;
-          }
-
-        }
-        UNLOCK(ghMutex);
+      // Stage DP, added to table by the flush thread
+      PushDP(ph,gpuFound);
+
+      // Collision inside the same herd, respawn the dead kangaroos in one batch
+      uint64_t kIdx;
+      dead.clear();
+      while(ph->deadQueue->Pop(&kIdx))
+        dead.push_back(kIdx);
+      if(dead.size() > 0) {
+        RespawnKangaroos(ph->threadId,dead,rPx,rPy,rD);
+        gpu->SetKangaroos(dead,rPx.data(),rPy.data(),rD.data());
       }
 
     }
@@ -737,56 +862,294 @@ void *_ScanGapsThread(void *lpParam) {
   return 0;
 }
 
+#ifdef WIN64
+DWORD WINAPI _FlushDPThread(LPVOID lpParam) {
+#else
+void *_FlushDPThread(void *lpParam) {
+#endif
+  TH_PARAM *p = (TH_PARAM *)lpParam;
+  p->obj->FlushDPThread(p);
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+void Kangaroo::StartCPUWorker(TH_PARAM *params,int i) {
+
+  params[i].threadId = i;
+  params[i].isRunning = true;
+  params[i].stopRequest = false;
+  params[i].isLaunched = true;
+  walkerHandles[i] = LaunchThread(_SolveKeyCPU,params + i);
+
+}
+
+void Kangaroo::StopCPUWorker(TH_PARAM *params,int i) {
+
+  params[i].stopRequest = true;
+  while(params[i].isRunning)
+    Timer::SleepMillis(1);
+  JoinThreads(walkerHandles + i,1);
+  FreeHandles(walkerHandles + i,1);
+  params[i].isLaunched = false;
+
+}
+
+// ----------------------------------------------------------------------------
+
+int Kangaroo::ReadCtlFile() {
+
+  // Wanted number of CPU walkers, -1 if not available
+  FILE *f = fopen(ctlFile.c_str(),"r");
+  if(f == NULL)
+    return -1;
+  int n;
+  if(fscanf(f,"%d",&n) != 1)
+    n = -1;
+  fclose(f);
+  return n;
+
+}
+
+void Kangaroo::ScaleCPU(TH_PARAM *params) {
+
+  // Running walkers are slots [0,nbCPUActive), the parked slots above keep
+  // their herd (pool) and the next started worker of the slot reuses it.
+  int n = ReadCtlFile();
+  if(n < 0)
+    return;
+  if(n > nbCPUThread) n = nbCPUThread;
+  if(n < 1 && nbGPUThread == 0) n = 1;
+  if(n == nbCPUActive)
+    return;
+
+  ::printf("\nWorkers: %d -> %d CPU thread(s)\n",nbCPUActive,n);
+
+  while(nbCPUActive > n) {
+    nbCPUActive--;
+    StopCPUWorker(params,nbCPUActive);
+  }
+  while(nbCPUActive < n) {
+    if(params[nbCPUActive].px == NULL)
+      totalRW += CPU_GRP_SIZE;
+    StartCPUWorker(params,nbCPUActive);
+    nbCPUActive++;
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
+void Kangaroo::RespawnKangaroos(int thId,vector<uint64_t> &kIdx,vector<Int> &px,vector<Int> &py,vector<Int> &d) {
+
+  // Dead kangaroos of a worker, one shared inversion for the whole batch
+  int nb = (int)kIdx.size();
+  if(nb == 0)
+    return;
+  if((int)px.size() < nb) {
+    px.resize(nb);
+    py.resize(nb);
+    d.resize(nb);
+  }
+  CreateHerd(nb,px.data(),py.data(),d.data(),0,kIdx.data(),thId);
+
+}
+
+// ----------------------------------------------------------------------------
+
+void Kangaroo::SeedHerd(int nbKangaroo,Int *d,int firstType,vector<Point> &S) {
+
+  // Random base points, the rest of the herd is derived by chains of
+  // small random steps, (k+1).unit for k in [0,2^FAST_SEED_BIT), taken from
+  // a precomputed table. nbChain is even so all the kangaroos of a chain
+  // have the same type, kangaroo j is the (j / nbChain)th step of chain
+  // j % nbChain and a step of all the chains is one batched addition.
+  int nbChain = (nbKangaroo + FAST_SEED_RUN - 1) / FAST_SEED_RUN;
+  nbChain = (nbChain + 1) & ~1;
+  int nbStep = (nbKangaroo + nbChain - 1) / nbChain;
+  int nbOffset = 1 << FAST_SEED_BIT;
+
+  // A chain spans about 1/nbChain of the range, bases are drawn uniformly
+  // below 2^bits - maxSpan so that the chains stay in the range
+  int bits = symmetry ? rangePower - 1 : rangePower;
+  int logK = 0;
+  while((1 << logK) < nbKangaroo) logK++;
+  int logStep = 0;
+  while((1 << logStep) < nbStep) logStep++;
+  int unitBit = bits - logK - FAST_SEED_BIT + 1;
+  if(unitBit < 0) unitBit = 0;
+  Int unit;
+  unit.SetInt32(1);
+  unit.ShiftL(unitBit);
+  Int limit;
+  Int maxSpan;
+  limit.SetInt32(1);
+  limit.ShiftL(bits);
+  maxSpan.Set(&unit);
+  maxSpan.ShiftL(logStep + FAST_SEED_BIT);
+  limit.Sub(&maxSpan);
+
+  // Step table, doubled in size by each batched addition
+  vector<Point> p1;
+  vector<Point> p2;
+  vector<Point> P;
+  vector<Int> stepD(nbOffset);
+  vector<Point> stepP(nbOffset);
+  stepD[0].Set(&unit);
+  for(int i = 1; i < nbOffset; i++) {
+    stepD[i].Set(&stepD[i - 1]);
+    stepD[i].Add(&unit);
+  }
+  stepP[0] = secp->ComputePublicKey(&unit);
+  for(int n = 1; n < nbOffset; n *= 2) {
+    // (i+1+n).unit = (i+1).unit + n.unit
+    if(n > 1) {
+      p1.assign(stepP.begin(),stepP.begin() + (n - 1));
+      p2.assign(n - 1,stepP[n - 1]);
+      P = secp->AddDirect(p1,p2);
+      for(int i = 0; i < n - 1; i++)
+        stepP[n + i] = P[i];
+    }
+    stepP[2 * n - 1] = secp->DoubleDirect(stepP[n - 1]);
+  }
+
+  // Random bases and steps
+  vector<Int> base(nbChain);
+  vector<uint32_t> offset(nbKangaroo);
+  for(int c = 0; c < nbChain; c++) {
+    do {
+      base[c].RandQ(bits);
+    } while(base[c].IsGreaterOrEqual(&limit));
+    if(GetHerd((uint64_t)(c + firstType)) == WILD)
+      base[c].ModSubK1order(symmetry ? &rangeWidthDiv4 : &rangeWidthDiv2);
+  }
+  for(int j = 0; j < nbKangaroo; j++)
+    offset[j] = (uint32_t)rndq() & (nbOffset - 1);
+
+  S.resize(nbKangaroo);
+  P = secp->ComputePublicKeys(base);
+  for(int c = 0; c < nbChain && c < nbKangaroo; c++) {
+    d[c].Set(&base[c]);
+    S[c] = P[c];
+  }
+
+  for(int i = 1; i < nbStep; i++) {
+    int start = i * nbChain;
+    int nb = (nbKangaroo - start < nbChain) ? nbKangaroo - start : nbChain;
+    p1.clear();
+    p2.clear();
+    for(int c = 0; c < nb; c++) {
+      p1.push_back(S[start - nbChain + c]);
+      p2.push_back(stepP[offset[start + c]]);
+    }
+    P = secp->AddDirect(p1,p2);
+    for(int c = 0; c < nb; c++) {
+      S[start + c] = P[c];
+      d[start + c].Set(&d[start - nbChain + c]);
+      d[start + c].ModAddK1order(&stepD[offset[start + c]]);
+    }
+  }
+
+}
+
 // ----------------------------------------------------------------------------
 
-void Kangaroo::CreateHerd(int nbKangaroo,Int *px,Int *py,Int *d,int firstType,bool lock) {
+void Kangaroo::CreateHerd(int nbKangaroo,Int *px,Int *py,Int *d,int firstType,uint64_t *kIdx,int thId) {
 
   vector<Int> pk;
   vector<Point> S;
   vector<Point> Sp;
-  pk.reserve(nbKangaroo);
-  S.reserve(nbKangaroo);
   Sp.reserve(nbKangaroo);
   Point Z;
   Z.Clear();
 
-  // Choose random starting distance
-  if(lock) LOCK(ghMutex);
+  if(fastSeed && method == 2 && !gaudrySchost && kIdx == NULL && nbKangaroo >= FAST_SEED_MIN) {
 
-  for(int j = 0; j<nbKangaroo; j++) {
+    SeedHerd(nbKangaroo,d,firstType,S);
 
-#ifdef USE_SYMMETRY
+  } else {
 
-    // Tame in [0..N/2]
-    d[j].Rand(rangePower - 1);
-    if((j+ firstType) % 2 == WILD) {
-      // Wild in [-N/4..N/4]
-      d[j].ModSubK1order(&rangeWidthDiv4);
-    }
+    pk.reserve(nbKangaroo);
+
+    // Even offsets for -method 4
+    Int one;
+    one.SetInt32(1);
+    Int tameOffset(&rangeWidthDiv4);
+    tameOffset.ShiftL(1);
+    Int wildOffset(&rangeWidthDiv8);
+    wildOffset.ShiftL(1);
+
+    // Choose random starting distance (per thread stream, no lock)
+    for(int j = 0; j<nbKangaroo; j++) {
+
+      // Type from the herd index when respawning
+      int kType = GetHerd(kIdx ? kIdx[j] : (uint64_t)(j + firstType));
+
+      if(method == 4) {
+
+        // Tame in [-N/2..N/2], even (TAME) or odd (TAME2), wild even in
+        // [-N/4..N/4] from key (WILD) or -key (WILD2). Jumps are even, a
+        // parity class holds one tame herd and the two wild herds.
+        if(kType == TAME || kType == TAME2) {
+          d[j].RandQ(rangePower - 1);
+          d[j].ShiftL(1);
+          d[j].ModSubK1order(&tameOffset);
+          if(kType == TAME2)
+            d[j].ModAddK1order(&one);
+        } else {
+          d[j].RandQ(rangePower > 2 ? rangePower - 2 : 1);
+          d[j].ShiftL(1);
+          d[j].ModSubK1order(&wildOffset);
+        }
 
-#else
+      } else if(symmetry) {
 
-    // Tame in [0..N]
-    d[j].Rand(rangePower);
-    if((j + firstType) % 2 == WILD) {
-      // Wild in [-N/2..N/2]
-      d[j].ModSubK1order(&rangeWidthDiv2);
-    }
+        // Tame in [0..N/2]
+        d[j].RandQ(rangePower - 1);
+        if(kType == WILD) {
+          // Wild in [-N/4..N/4]
+          d[j].ModSubK1order(&rangeWidthDiv4);
+        }
 
-#endif
+      } else if(gaudrySchost) {
 
-    pk.push_back(d[j]);
+        if(kType == WILD) {
+          // Wild in [-N/4..N/4]
+          d[j].RandQ(rangePower - 1);
+          d[j].ModSubK1order(&rangeWidthDiv4);
+        } else {
+          // Tame in [0..N]
+          d[j].RandQ(rangePower);
+        }
 
-  }
+      } else {
+
+        // Tame in [0..N]
+        d[j].RandQ(rangePower);
+        if(kType == WILD) {
+          // Wild in [-N/2..N/2]
+          d[j].ModSubK1order(&rangeWidthDiv2);
+        }
+
+      }
+
+      pk.push_back(d[j]);
+
+    }
 
-  if(lock) UNLOCK(ghMutex);
+    // Compute starting pos
+    S = secp->ComputePublicKeys(pk);
 
-  // Compute starting pos
-  S = secp->ComputePublicKeys(pk);
+  }
 
   for(int j = 0; j<nbKangaroo; j++) {
-    if((j + firstType) % 2 == TAME) {
+    int kType = GetHerd(kIdx ? kIdx[j] : (uint64_t)(j + firstType));
+    if(kType == TAME || kType == TAME2) {
       Sp.push_back(Z);
+    } else if(kType == WILD2) {
+      Sp.push_back(keyToSearchNeg);
+    } else if(multiKey) {
+      Sp.push_back(mkKey[GetWildKey(thId,kIdx ? kIdx[j] : (uint64_t)j)]);
     } else {
       Sp.push_back(keyToSearch);
     }
@@ -799,11 +1162,9 @@ void Kangaroo::CreateHerd(int nbKangaroo,Int *px,Int *py,Int *d,int firstType,bo
     px[j].Set(&S[j].x);
     py[j].Set(&S[j].y);
 
-#ifdef USE_SYMMETRY
     // Equivalence symmetry class switch
-    if( py[j].ModPositiveK1() )
+    if(symmetry && py[j].ModPositiveK1())
       d[j].ModNegK1order();
-#endif
 
   }
 
@@ -811,13 +1172,43 @@ void Kangaroo::CreateHerd(int nbKangaroo,Int *px,Int *py,Int *d,int firstType,bo
 
 // ----------------------------------------------------------------------------
 
+double Kangaroo::CreateHerds(uint64_t nbKangaroo,Int *px,Int *py,Int *d) {
+
+  // Large herd on all cores, HERD_CHUNK kangaroos per CreateHerd() call.
+  // Chunks are even, the kangaroo type stays the parity of the index.
+  // Return the creation rate (kangaroo/s).
+  double t0 = Timer::get_tick();
+  uint64_t nbChunk = (nbKangaroo + HERD_CHUNK - 1) / HERD_CHUNK;
+  uint64_t nbThread = (uint64_t)Timer::getCoreNumber();
+  if(nbThread > nbChunk) nbThread = nbChunk;
+
+  std::atomic<uint64_t> next(0);
+  auto work = [&]() {
+    uint64_t c;
+    while((c = next++) < nbChunk) {
+      uint64_t start = c * HERD_CHUNK;
+      uint64_t nb = (nbKangaroo - start < HERD_CHUNK) ? nbKangaroo - start : HERD_CHUNK;
+      CreateHerd((int)nb,px + start,py + start,d + start,TAME);
+    }
+  };
+
+  vector<std::thread> th;
+  for(uint64_t i = 1; i < nbThread; i++)
+    th.push_back(std::thread(work));
+  work();
+  for(int i = 0; i < (int)th.size(); i++)
+    th[i].join();
+
+  double t1 = Timer::get_tick();
+  return (t1 > t0) ? (double)nbKangaroo / (t1 - t0) : 0.0;
+
+}
+
+// ----------------------------------------------------------------------------
+
 void Kangaroo::CreateJumpTable() {
 
-#ifdef USE_SYMMETRY
-  int jumpBit = rangePower / 2;
-#else
-  int jumpBit = rangePower / 2 + 1;
-#endif
+  int jumpBit = symmetry ? rangePower / 2 : rangePower / 2 + 1;
 
   if(jumpBit > 256) jumpBit = 256;
   int maxRetry = 100;
@@ -832,59 +1223,62 @@ void Kangaroo::CreateJumpTable() {
   // Constant seed for compatibilty of workfiles
   rseed(0x600DCAFE);
 
-#ifdef USE_SYMMETRY
-  Int old;
-  old.Set(Int::GetFieldCharacteristic());
   Int u;
   Int v;
-  u.SetInt32(1);
-  u.ShiftL(jumpBit/2);
-  u.AddOne();
-  while(!u.IsProbablePrime()) {
-    u.AddOne();
+  if(symmetry) {
+    Int old;
+    old.Set(Int::GetFieldCharacteristic());
+    u.SetInt32(1);
+    u.ShiftL(jumpBit/2);
     u.AddOne();
-  }
-  v.Set(&u);
-  v.AddOne();
-  v.AddOne();
-  while(!v.IsProbablePrime()) {
+    while(!u.IsProbablePrime()) {
+      u.AddOne();
+      u.AddOne();
+    }
+    v.Set(&u);
     v.AddOne();
     v.AddOne();
-  }
-  Int::SetupField(&old);
+    while(!v.IsProbablePrime()) {
+      v.AddOne();
+      v.AddOne();
+    }
+    Int::SetupField(&old);
 
-  ::printf("U= %s\n",u.GetBase16().c_str());
-  ::printf("V= %s\n",v.GetBase16().c_str());
-#endif
+    ::printf("U= %s\n",u.GetBase16().c_str());
+    ::printf("V= %s\n",v.GetBase16().c_str());
+  }
 
   // Positive only
   // When using symmetry, the sign is switched by the symmetry class switch
   while(!ok && maxRetry>0 ) {
     Int totalDist;
     totalDist.SetInt32(0);
-#ifdef USE_SYMMETRY
-    for(int i = 0; i < NB_JUMP/2; ++i) {
-      jumpDistance[i].Rand(jumpBit/2);
-      jumpDistance[i].Mult(&u);
-      if(jumpDistance[i].IsZero())
-        jumpDistance[i].SetInt32(1);
-      totalDist.Add(&jumpDistance[i]);
-    }
-    for(int i = NB_JUMP / 2; i < NB_JUMP; ++i) {
-      jumpDistance[i].Rand(jumpBit/2);
-      jumpDistance[i].Mult(&v);
-      if(jumpDistance[i].IsZero())
-        jumpDistance[i].SetInt32(1);
-      totalDist.Add(&jumpDistance[i]);
+    if(symmetry) {
+      for(int i = 0; i < NB_JUMP/2; ++i) {
+        jumpDistance[i].Rand(jumpBit/2);
+        jumpDistance[i].Mult(&u);
+        if(jumpDistance[i].IsZero())
+          jumpDistance[i].SetInt32(1);
+        totalDist.Add(&jumpDistance[i]);
+      }
+      for(int i = NB_JUMP / 2; i < NB_JUMP; ++i) {
+        jumpDistance[i].Rand(jumpBit/2);
+        jumpDistance[i].Mult(&v);
+        if(jumpDistance[i].IsZero())
+          jumpDistance[i].SetInt32(1);
+        totalDist.Add(&jumpDistance[i]);
+      }
+    } else {
+      for(int i = 0; i < NB_JUMP; ++i) {
+        jumpDistance[i].Rand(jumpBit);
+        // Even jumps keep the parity classes of -method 4
+        if(method == 4)
+          jumpDistance[i].bits64[0] &= ~1ULL;
+        if(jumpDistance[i].IsZero())
+          jumpDistance[i].SetInt32(method == 4 ? 2 : 1);
+        totalDist.Add(&jumpDistance[i]);
+      }
     }
-#else
-    for(int i = 0; i < NB_JUMP; ++i) {
-      jumpDistance[i].Rand(jumpBit);
-      if(jumpDistance[i].IsZero())
-        jumpDistance[i].SetInt32(1);
-      totalDist.Add(&jumpDistance[i]);
-  }
-#endif
     distAvg = totalDist.ToDouble() / (double)(NB_JUMP);
     ok = distAvg>minAvg && distAvg<maxAvg;
     maxRetry--;
@@ -896,6 +1290,14 @@ void Kangaroo::CreateJumpTable() {
     jumpPointy[i].Set(&J.y);
   }
 
+  // Fruitless cycle escape jump (symmetry), outside of the u/v lattices
+  escapeDistance.Rand(jumpBit);
+  if(escapeDistance.IsZero())
+    escapeDistance.SetInt32(1);
+  Point E = secp->ComputePublicKey(&escapeDistance);
+  escapePointx.Set(&E.x);
+  escapePointy.Set(&E.y);
+
   ::printf("Jump Avg distance: 2^%.2f\n",log2(distAvg));
 
   unsigned long seed = Timer::getSeed32();
@@ -905,15 +1307,13 @@ void Kangaroo::CreateJumpTable() {
 
 // ----------------------------------------------------------------------------
 
-void Kangaroo::ComputeExpected(double dp,double *op,double *ram,double *overHead) {
+void Kangaroo::ComputeExpected(double dp,double *op,double *ram,double *overHead,bool other) {
 
-  // Compute expected number of operation and memory
+  // Compute expected number of operation and memory, for the other solver
+  // (kangaroo or Gaudry-Schost) if other is set
+  bool gs = gaudrySchost != other;
 
-#ifdef USE_SYMMETRY
-  double gainS = 1.0 / sqrt(2.0);
-#else
-  double gainS = 1.0;
-#endif
+  double gainS = symmetry ? 1.0 / sqrt(2.0) : 1.0;
 
   // Kangaroo number
   double k = (double)totalRW;
@@ -927,11 +1327,30 @@ void Kangaroo::ComputeExpected(double dp,double *op,double *ram,double *overHead
   // Z0
   double Z0 = (2.0 * (2.0 - sqrt(2.0)) * gainS) * sqrt(M_PI);
 
+  // 4-kangaroo method, 1.714 sqrt(N) (Galbraith, Pollard, Ruprai)
+  if(method == 4)
+    Z0 = 1.714;
+
   // Average for DP = 0
   double avgDP0 = Z0 * sqrt(N);
 
   // DP Overhead
-  *op = Z0 * pow(N * (k * theta + sqrt(N)),1.0 / 3.0);
+  double opK = Z0 * pow(N * (k * theta + sqrt(N)),1.0 / 3.0);
+
+  // Gaudry-Schost, 1.36 sqrt(N) with equivalence classes (Galbraith, Ruprai,
+  // PKC 2010). Tame [0,N] and wild [k-N/4,k+N/4] are the original regions,
+  // about 1.92 sqrt(N) (birthday simulation), the 1.661 sqrt(N) of Galbraith
+  // and Ruprai (Cryptography and Coding 2009) needs their improved sets.
+  // Plus 2^dp steps on all the walks for the colliding one to reach its DP.
+  double Zgs = symmetry ? 1.36 : 1.92;
+  double opGS = Zgs * sqrt(N) + k * theta;
+
+  if(gs) {
+    *op = opGS;
+    avgDP0 = Zgs * sqrt(N);
+  } else {
+    *op = opK;
+  }
 
   *ram = (double)sizeof(HASH_ENTRY) * (double)HASH_SIZE + // Table
          (double)sizeof(ENTRY *) * (double)(HASH_SIZE * 4) + // Allocation overhead
@@ -944,6 +1363,42 @@ void Kangaroo::ComputeExpected(double dp,double *op,double *ram,double *overHead
 
 }
 
+int Kangaroo::SuggestDP(bool other,double *cost) {
+
+  // Suggested DP of the current solver (or the other one), and its expected
+  // cost in steps. Kangaroo: largest DP for less than 5% overhead (see
+  // README). Gaudry-Schost: fewest steps, a restart (scalar multiplication)
+  // per DP included.
+  bool gs = gaudrySchost != other;
+  double op;
+  double ram;
+  double overHead;
+  int dp = (int)((double)rangePower / 2.0 - log2((double)totalRW));
+  if(dp < 0) dp = 0;
+
+  if(gs) {
+    double best = 0.0;
+    for(int d = 0; d <= rangePower / 2; d++) {
+      ComputeExpected((double)d,&op,&ram,NULL,other);
+      double t = op * (1.0 + GS_RESTART_COST / pow(2.0,(double)d));
+      if(d == 0 || t < best) {
+        best = t;
+        dp = d;
+      }
+    }
+    *cost = best;
+  } else {
+    ComputeExpected((double)dp,&op,&ram,&overHead,other);
+    while(overHead > 1.05 && dp > 0) {
+      dp--;
+      ComputeExpected((double)dp,&op,&ram,&overHead,other);
+    }
+    *cost = op;
+  }
+  return dp;
+
+}
+
 // ----------------------------------------------------------------------------
 
 void Kangaroo::InitRange() {
@@ -963,11 +1418,18 @@ void Kangaroo::InitRange() {
 
 void Kangaroo::InitSearchKey() {
 
+  // Key with its own range start, same width
+  if(keyStart.size() == keysToSearch.size()) {
+    rangeStart.Set(&keyStart[keyIdx]);
+    rangeEnd.Set(&rangeStart);
+    rangeEnd.Add(&rangeWidth);
+  }
+
+  // Centered on 0 for the symmetry and the 4-kangaroo method
   Int SP;
   SP.Set(&rangeStart);
-#ifdef USE_SYMMETRY
-  SP.ModAddK1order(&rangeWidthDiv2);
-#endif
+  if(symmetry || method == 4)
+    SP.ModAddK1order(&rangeWidthDiv2);
   if(!SP.IsZero()) {
     Point RS = secp->ComputePublicKey(&SP);
     RS.y.ModNeg();
@@ -982,6 +1444,150 @@ void Kangaroo::InitSearchKey() {
 
 // ----------------------------------------------------------------------------
 
+void Kangaroo::InitMultiKey() {
+
+  // All keys translated to [0,N], searched at once
+  int nbKey = (int)keysToSearch.size();
+  mkKey.resize(nbKey);
+  mkSolved.assign(nbKey,false);
+  delete[] mkSlotKey;
+  mkSlotKey = new int[nbKey];
+  for(keyIdx = 0; keyIdx < (uint32_t)nbKey; keyIdx++) {
+    InitSearchKey();
+    mkKey[keyIdx] = keyToSearch;
+    mkSlotKey[keyIdx] = keyIdx;
+  }
+  mkNbSolved = 0;
+  mkEpoch = 0;
+  SelectKey(0);
+
+}
+
+void Kangaroo::SelectKey(int k) {
+
+  // Current key for CheckKey() and Output()
+  keyIdx = k;
+  keyToSearch = mkKey[k];
+  keyToSearchNeg = keyToSearch;
+  keyToSearchNeg.y.ModNeg();
+  if(keyStart.size() == keysToSearch.size()) {
+    rangeStart.Set(&keyStart[k]);
+    rangeEnd.Set(&rangeStart);
+    rangeEnd.Add(&rangeWidth);
+  }
+
+}
+
+int Kangaroo::GetWildKey(int thId,uint64_t kIdx) {
+
+  // Wild kangaroos of all the herds are spread over the slots, the key is
+  // read from the map the walker thId currently uses
+  uint64_t w = ((uint64_t)thId * CPU_GRP_SIZE + kIdx) / 2;
+  return walkers[thId].mkSlotKey[w % keysToSearch.size()];
+
+}
+
+int Kangaroo::GetHerd(uint64_t idx) {
+
+  // Kangaroo type from the index (modulo the number of herds), a single
+  // herd with -tdb
+  if(tameDBBuild > 0)
+    return TAME;
+  if(tameDB)
+    return WILD;
+  return (int)(idx % method);
+
+}
+
+uint32_t Kangaroo::GetKType(int thId,uint64_t kIdx) {
+
+  // Hash table type: herd in bit 0, key of a multi-key wild above
+  uint32_t kType = (uint32_t)GetHerd(kIdx);
+  if(multiKey && kType == WILD)
+    kType |= (uint32_t)GetWildKey(thId,kIdx) << 1;
+  return kType;
+
+}
+
+void Kangaroo::ResyncMultiKey(TH_PARAM *ph,vector<uint64_t> &dead) {
+
+  // Wild kangaroos of a slot that moved to another key are respawned.
+  // mkSlotKey is written by CheckMultiKey() under ghMutex. The DP staged
+  // by this walker are flushed first, they are typed with the old map.
+  if(ph->mkEpoch == mkEpoch)
+    return;
+  int nbKey = (int)keysToSearch.size();
+  vector<bool> moved(nbKey,false);
+  LOCK(ghMutex);
+  FlushDP();
+  uint32_t epoch = mkEpoch;
+  for(int s = 0; s < nbKey; s++) {
+    int k = mkSlotKey[s];
+    if(ph->mkSlotKey[s] != k) {
+      moved[s] = true;
+      ph->mkSlotKey[s] = k;
+    }
+  }
+  UNLOCK(ghMutex);
+  for(uint64_t k = 0; k < ph->nbKangaroo; k++) {
+    if(GetHerd(k) != WILD)
+      continue;
+    uint64_t w = ((uint64_t)ph->threadId * CPU_GRP_SIZE + k) / 2;
+    if(moved[w % nbKey])
+      dead.push_back(k);
+  }
+  ph->mkEpoch = epoch;
+
+}
+
+// ----------------------------------------------------------------------------
+
+void Kangaroo::StartServerWalkers(int nbThread) {
+
+  // Local CPU walkers of a server (-s -t), their DP are staged in the walker
+  // queues and added to the server table by the flush thread
+  nbCPUThread = nbThread;
+  nbCPUActive = nbThread;
+  nbGPUThread = 0;
+
+  // Walkers + DP flush thread
+  TH_PARAM *params = (TH_PARAM *)malloc((nbThread + 1) * sizeof(TH_PARAM));
+  THREAD_HANDLE *thHandles = (THREAD_HANDLE *)malloc((nbThread + 1) * sizeof(THREAD_HANDLE));
+  memset(params,0,(nbThread + 1) * sizeof(TH_PARAM));
+  walkers = params;
+  walkerHandles = thHandles;
+  for(int i = 0; i < nbThread; i++) {
+    params[i].cpuId = -1;
+    params[i].dpQueue = new SPSCQueue<ITEM>(DP_QUEUE_SIZE);
+    params[i].deadQueue = new SPSCQueue<uint64_t>(DP_QUEUE_SIZE);
+  }
+  if(affinity) {
+    CPUTopology topo;
+    nbNode = topo.GetNbNode();
+    for(int i = 0; i < nbThread; i++) {
+      params[i].cpuId = topo.GetCPU(i);
+      params[i].node = topo.GetNode(params[i].cpuId);
+    }
+  }
+  memset(counters,0,sizeof(counters));
+
+  totalRW += (uint64_t)nbThread * CPU_GRP_SIZE;
+  CreateJumpTable();
+  ::printf("Local walkers: %d CPU thread(s), %s engine\n",nbThread,CPUEngine::GetName(cpuEngine));
+
+  FectchKangaroos(params);
+
+  for(int i = 0; i < nbThread; i++)
+    StartCPUWorker(params,i);
+
+  params[nbThread].threadId = 0xFE;
+  params[nbThread].isRunning = true;
+  thHandles[nbThread] = LaunchThread(_FlushDPThread,params + nbThread);
+
+}
+
+// ----------------------------------------------------------------------------
+
 void Kangaroo::Run(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize) {
 
   double t0 = Timer::get_tick();
@@ -990,6 +1596,10 @@ void Kangaroo::Run(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize
   nbGPUThread = (useGpu ? (int)gpuId.size() : 0);
   totalRW = 0;
 
+  // Group size and thread count for this host
+  if(autoTune)
+    AutoTune(&nbCPUThread);
+
 #ifndef WITHGPU
 
   if(nbGPUThread>0) {
@@ -1000,18 +1610,80 @@ void Kangaroo::Run(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize
 
 #endif
 
+  // Gaudry-Schost restarts are done by the CPU walkers only
+  if(gaudrySchost && nbGPUThread > 0) {
+    ::printf("Error: -gs is CPU only\n");
+    ::exit(-1);
+  }
+
+  // Multi-key, tame DP database and 4-kangaroo method, the table and the
+  // walkers of this process only
+  if(multiKey || tameDBFile.length() > 0 || method == 4) {
+    if(clientMode || nbGPUThread > 0 || inputFile.length() > 0) {
+      ::printf("Error: -multikey, -tdb and -method 4 are CPU only, not available in client mode or with -i\n");
+      ::exit(-1);
+    }
+    if(workFile.length() > 0 || workTextFile.length() > 0) {
+      ::printf("Warning: -multikey, -tdb or -method 4, work file disabled\n");
+      workFile = "";
+      workTextFile = "";
+    }
+  }
+
+  // Elastic scaling, slots up to the core count, -t (or autotune) workers
+  // running unless the control file says otherwise
+  nbCPUActive = nbCPUThread;
+  if(ctlFile.length() > 0) {
+    nbCPUThread = std::max(nbCPUThread,Timer::getCoreNumber());
+    if(nbCPUThread > MAX_CPU_SLOT) nbCPUThread = MAX_CPU_SLOT;
+    int n = ReadCtlFile();
+    if(n >= 0) {
+      nbCPUActive = std::min(n,nbCPUThread);
+    } else {
+      FILE *f = fopen(ctlFile.c_str(),"w");
+      if(f) {
+        fprintf(f,"%d\n",nbCPUActive);
+        fclose(f);
+      }
+    }
+    if(nbCPUActive < 1 && nbGPUThread == 0) nbCPUActive = 1;
+  }
+
   uint64_t totalThread = (uint64_t)nbCPUThread + (uint64_t)nbGPUThread;
   if(totalThread == 0) {
     ::printf("No CPU or GPU thread, exiting.\n");
     ::exit(0);
   }
 
-  TH_PARAM *params = (TH_PARAM *)malloc(totalThread * sizeof(TH_PARAM));
-  THREAD_HANDLE *thHandles = (THREAD_HANDLE *)malloc(totalThread * sizeof(THREAD_HANDLE));
-
-  memset(params, 0,totalThread * sizeof(TH_PARAM));
+  // Walkers + gap scan thread + DP flush thread
+  TH_PARAM *params = (TH_PARAM *)malloc((totalThread + 2) * sizeof(TH_PARAM));
+  THREAD_HANDLE *thHandles = (THREAD_HANDLE *)malloc((totalThread + 2) * sizeof(THREAD_HANDLE));
+
+  memset(params, 0,(totalThread + 2) * sizeof(TH_PARAM));
+  walkers = params;
+  walkerHandles = thHandles;
+  for(uint64_t i = 0; i < totalThread; i++)
+    params[i].cpuId = -1;
+  if(affinity && nbCPUThread > 0) {
+    CPUTopology topo;
+    nbNode = topo.GetNbNode();
+    ::printf("CPU affinity: %d cpu(s) on %d node(s)\n",topo.GetNbCPU(),nbNode);
+    for(int i = 0; i < nbCPUThread; i++) {
+      params[i].cpuId = topo.GetCPU(i);
+      params[i].node = topo.GetNode(params[i].cpuId);
+    }
+  }
+  if(!clientMode) {
+    for(uint64_t i = 0; i < totalThread; i++) {
+      params[i].dpQueue = new SPSCQueue<ITEM>(DP_QUEUE_SIZE);
+      params[i].deadQueue = new SPSCQueue<uint64_t>(DP_QUEUE_SIZE);
+    }
+  }
   memset(counters, 0, sizeof(counters));
-  ::printf("Number of CPU thread: %d\n", nbCPUThread);
+  if(ctlFile.length() > 0)
+    ::printf("Number of CPU thread: %d (up to %d, control file %s)\n",nbCPUActive,nbCPUThread,ctlFile.c_str());
+  else
+    ::printf("Number of CPU thread: %d\n", nbCPUThread);
 
 #ifdef WITHGPU
 
@@ -1031,7 +1703,7 @@ void Kangaroo::Run(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize
 
 #endif
 
-  totalRW += nbCPUThread * (uint64_t)CPU_GRP_SIZE;
+  totalRW += nbCPUActive * (uint64_t)CPU_GRP_SIZE;
 
   // Set starting parameters
   if( clientMode ) {
@@ -1043,29 +1715,100 @@ void Kangaroo::Run(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize
       saveKangaroo = true;
   }
 
+#ifdef WITHGPU
+  // The GPU kernel walk is still selected at compile time
+#ifdef USE_SYMMETRY
+  bool gpuSymmetry = true;
+#else
+  bool gpuSymmetry = false;
+#endif
+  if(nbGPUThread > 0 && gpuSymmetry != symmetry) {
+    ::printf("Error: GPU kernel built %s USE_SYMMETRY, symmetry is %s\n",
+             gpuSymmetry ? "with" : "without",symmetry ? "on" : "off");
+    ::exit(-1);
+  }
+#endif
+
+  if(symmetry)
+    ::printf("Symmetry: on (fruitless cycle window %d)\n",CYCLE_WINDOW);
+  if(method == 4)
+    ::printf("Method: 4 kangaroos (2 tame, wild from key and -key)\n");
+  if(gaudrySchost)
+    ::printf("Solver: Gaudry-Schost (walks restarted after each DP)\n");
+  if(fastSeed && method == 2 && !gaudrySchost)
+    ::printf("Herd seeding: fast (%d kangaroos per chain, 2^%d steps)\n",FAST_SEED_RUN,FAST_SEED_BIT);
+
   InitRange();
   CreateJumpTable();
 
+  // Tame DP database, same width, symmetry and jump table, its DP size
+  if(tameDBFile.length() > 0 && tameDBBuild == 0) {
+    tameDB = new TameDB();
+    if(!tameDB->Load(tameDBFile))
+      ::exit(-1);
+    TDB_HEADER *h = &tameDB->head;
+    if(h->rangePower != (uint32_t)rangePower || h->symmetry != (uint32_t)symmetry ||
+       h->jumpHash != TameDB::GetJumpHash(jumpDistance,NB_JUMP)) {
+      ::printf("Error: %s was built for a 2^%d range, symmetry %s, or another jump table\n",tameDBFile.c_str(),
+               h->rangePower,h->symmetry ? "on" : "off");
+      ::exit(-1);
+    }
+    if(initDPSize >= 0 && initDPSize != (int)h->dpSize)
+      ::printf("Warning: DP size %d from the tame database\n",h->dpSize);
+    initDPSize = (int)h->dpSize;
+    ::printf("TameDB: %.0f tame DP, mapped from %s\n",(double)h->nbEntry,tameDBFile.c_str());
+  }
+
   ::printf("Number of kangaroos: 2^%.2f\n",log2((double)totalRW));
 
   if( !clientMode ) {
 
-    // Compute suggested distinguished bits number for less than 5% overhead (see README)
-    double dpOverHead;
-    int suggestedDP = (int)((double)rangePower / 2.0 - log2((double)totalRW));
-    if(suggestedDP<0) suggestedDP=0;
-    ComputeExpected((double)suggestedDP,&expectedNbOp,&expectedMem,&dpOverHead);
-    while(dpOverHead>1.05 && suggestedDP>0) {
-      suggestedDP--;
-      ComputeExpected((double)suggestedDP,&expectedNbOp,&expectedMem,&dpOverHead);
-    }
+    // Compute suggested distinguished bits number
+    double cost;
+    int suggestedDP = SuggestDP(false,&cost);
 
+    if(tameDBBuild > 0 && initDPSize < 0) {
+      // Walks of about sqrt(N/T) steps for T tame DP (Bernstein-Lange)
+      int bits = symmetry ? rangePower - 1 : rangePower;
+      initDPSize = (int)(((double)bits - log2((double)tameDBBuild)) / 2.0);
+      if(initDPSize < 0) initDPSize = 0;
+    }
     if(initDPSize < 0)
-      initDPSize = suggestedDP;
+      initDPSize = (autoTune && tuneRate > 0.0) ? AutoTuneDP() : suggestedDP;
 
+    // The other solver at its own suggested DP, Gaudry-Schost with restarts
+    double otherNbOp;
+    SuggestDP(true,&otherNbOp);
+    double restart = gaudrySchost ? 1.0 + GS_RESTART_COST / pow(2.0,(double)initDPSize) : 1.0;
     ComputeExpected((double)initDPSize,&expectedNbOp,&expectedMem);
+    if(multiKey) {
+      // L keys sharing the tame herd, about sqrt(L) times a single key
+      double f = sqrt((double)keysToSearch.size());
+      expectedNbOp *= f;
+      expectedMem *= f;
+      otherNbOp *= f;
+      ::printf("Multi-key: %d keys, one tame herd\n",(int)keysToSearch.size());
+    }
+    if(tameDBBuild > 0) {
+      // Tame walks until the wanted number of DP
+      expectedNbOp = (double)tameDBBuild * pow(2.0,(double)initDPSize);
+      expectedMem = (double)tameDBBuild * (double)(sizeof(ENTRY) + sizeof(ENTRY *)) / (1024.0 * 1024.0);
+    } else if(tameDB) {
+      // Wild walks only, N/(T.2^dp) steps to land on a tame walk, then
+      // 2^dp steps per kangaroo to reach a DP
+      double n = pow(2.0,(double)(symmetry ? rangePower - 1 : rangePower));
+      double theta = pow(2.0,(double)initDPSize);
+      expectedNbOp = n / ((double)tameDB->head.nbEntry * theta) + (double)totalRW * theta;
+      if(multiKey) expectedNbOp *= (double)keysToSearch.size();
+    }
     if(nbLoadedWalk == 0) ::printf("Suggested DP: %d\n",suggestedDP);
-    ::printf("Expected operations: 2^%.2f\n",log2(expectedNbOp));
+    if(gaudrySchost)
+      ::printf("Expected operations: 2^%.2f (2^%.2f with restarts, kangaroo 2^%.2f)\n",log2(expectedNbOp),
+               log2(expectedNbOp * restart),log2(otherNbOp));
+    else if(method == 2 && tameDB == NULL && tameDBBuild == 0)
+      ::printf("Expected operations: 2^%.2f (Gaudry-Schost 2^%.2f with restarts)\n",log2(expectedNbOp),log2(otherNbOp));
+    else
+      ::printf("Expected operations: 2^%.2f\n",log2(expectedNbOp));
     ::printf("Expected RAM: %.1fMB\n",expectedMem);
 
   } else {
@@ -1077,6 +1820,27 @@ void Kangaroo::Run(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize
 
   SetDP(initDPSize);
 
+  // Baby-step giant-step when faster (small ranges)
+  uint64_t nbBaby;
+  if(!clientMode && SelectBSGS(&nbBaby)) {
+    SolveBSGS(nbBaby);
+    for(uint64_t i = 0; i < totalThread; i++) {
+      delete params[i].dpQueue;
+      delete params[i].deadQueue;
+    }
+    double t1 = Timer::get_tick();
+    ::printf("\nDone: Total time %s \n",GetTimeStr(t1 - t0 + offsetTime).c_str());
+    return;
+  }
+
+  if(nbCPUThread > 0) {
+    ::printf("CPU engine: %s%s\n",CPUEngine::GetName(cpuEngine),
+             (rangePower < NARROW_RANGE_BIT) ? " (narrow distance)" : "");
+    // Scalar baseline for the per core gain
+    if(cpuEngine != CPU_ENGINE_SCALAR && cpuScalarRate == 0.0)
+      cpuScalarRate = CPUEngineRate(CPU_ENGINE_SCALAR,0.25);
+  }
+
   // Fetch kangaroos (if any)
   FectchKangaroos(params);
 
@@ -1093,7 +1857,10 @@ void Kangaroo::Run(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize
 
     for(keyIdx = 0; keyIdx < keysToSearch.size(); keyIdx++) {
 
-      InitSearchKey();
+      if(multiKey)
+        InitMultiKey();
+      else
+        InitSearchKey();
 
       endOfSearch = false;
       collisionInSameHerd = 0;
@@ -1132,8 +1899,14 @@ void Kangaroo::Run(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize
       // Lanch CPU threads
       for(int i = 0; i < nbCPUThread; i++) {
         params[i].threadId = i;
-        params[i].isRunning = true;
-        thHandles[i] = LaunchThread(_SolveKeyCPU,params + i);
+        if(profile) params[i].prof = new CPUProfile();
+        if(multiKey) {
+          params[i].mkSlotKey = new int[keysToSearch.size()];
+          memcpy(params[i].mkSlotKey,mkSlotKey,keysToSearch.size() * sizeof(int));
+          params[i].mkEpoch = 0;
+        }
+        if(i < nbCPUActive)
+          StartCPUWorker(params,i);
       }
 
 #ifdef WITHGPU
@@ -1154,13 +1927,65 @@ void Kangaroo::Run(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize
       params[gapThreadId].threadId = 0xFF;
       params[gapThreadId].isRunning = true;
       thHandles[gapThreadId] = LaunchThread(_ScanGapsThread,params + gapThreadId);
+      int nbThread = nbCPUThread + nbGPUThread + 1;
+
+      // Launch DP flush thread
+      if(!clientMode) {
+        int flushThreadId = nbCPUThread + nbGPUThread + 1;
+        params[flushThreadId].threadId = 0xFE;
+        params[flushThreadId].isRunning = true;
+        if(profile) params[flushThreadId].prof = new CPUProfile();
+        thHandles[flushThreadId] = LaunchThread(_FlushDPThread,params + flushThreadId);
+        nbThread++;
+      }
 
       // Wait for end
       Process(params,"MK/s");
-      JoinThreads(thHandles,nbCPUThread + nbGPUThread + 1);
-      FreeHandles(thHandles,nbCPUThread + nbGPUThread + 1);
+      for(int i = 0; i < nbCPUThread; i++) {
+        if(params[i].isLaunched)
+          StopCPUWorker(params,i);
+        // Parked herds belong to this key
+        safe_delete_array(params[i].px);
+        safe_delete_array(params[i].py);
+        safe_delete_array(params[i].distance);
+        params[i].nbKangaroo = 0;
+      }
+      JoinThreads(thHandles + nbCPUThread,nbThread - nbCPUThread);
+      FreeHandles(thHandles + nbCPUThread,nbThread - nbCPUThread);
+      PrintWalkStats(params);
+      if(profile) {
+        PrintProfile(params);
+        for(int i = 0; i < nbThread; i++) {
+          delete params[i].prof;
+          params[i].prof = NULL;
+        }
+      }
+      if(!clientMode)
+        HugePage::PrintCoverage("Key end: ");
+      if(tameDBBuild > 0)
+        TameDB::Save(tameDBFile,&hashTable,rangePower,symmetry,dpSize,TameDB::GetJumpHash(jumpDistance,NB_JUMP));
       hashTable.Reset();
 
+      // Discard DP staged for this key
+      if(!clientMode) {
+        ITEM it;
+        uint64_t kIdx;
+        for(uint64_t i = 0; i < totalThread; i++) {
+          while(params[i].dpQueue->Pop(&it));
+          while(params[i].deadQueue->Pop(&kIdx));
+        }
+      }
+
+      // All the keys in one pass
+      if(multiKey) {
+        for(int i = 0; i < nbCPUThread; i++)
+          safe_delete_array(params[i].mkSlotKey);
+        ::printf("\nMulti-key: %d/%d keys solved\n",mkNbSolved,(int)keysToSearch.size());
+        break;
+      }
+      if(tameDBBuild > 0)
+        break;
+
 #ifdef STATS
 
       uint64_t count = getCPUCount() + getGPUCount();
@@ -1182,6 +2007,13 @@ void Kangaroo::Run(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize
 
   }
 
+  for(uint64_t i = 0; i < totalThread; i++) {
+    delete params[i].dpQueue;
+    delete params[i].deadQueue;
+  }
+  delete tameDB;
+  tameDB = NULL;
+
   double t1 = Timer::get_tick();
 
   ::printf("\nDone: Total time %s \n" , GetTimeStr(t1-t0+offsetTime).c_str());
@@ -44,8 +44,12 @@ typedef int SOCKET;
 #include <vector>
 #include "SECPK1/SECP256k1.h"
 #include "HashTable.h"
+#include "TameDB.h"
 #include "SECPK1/IntGroup.h"
 #include "GPU/GPUEngine.h"
+#include "CPU/CPUEngine.h"
+#include "CPU/Topology.h"
+#include "SPSCQueue.h"
 
 #ifdef WIN64
 typedef HANDLE THREAD_HANDLE;
@@ -68,7 +72,16 @@ typedef struct {
   bool isRunning;
   bool hasStarted;
   bool isWaiting;
+  bool stopRequest; // Elastic scaling: park the worker, the herd stays in the slot
+  bool isLaunched;  // Thread handle to join
   uint64_t nbKangaroo;
+  uint64_t nbEscape; // Fruitless cycle escapes (symmetry)
+  uint64_t nbStuck;  // Kangaroos reset by the stuck walk watchdog
+  uint64_t dpHist[DPL_BUCKET]; // DP inter-arrival histogram (CPUEngine)
+  double createRate; // Herd creation rate (kangaroo/s), 0 if loaded
+  int  cpuId; // Pinned cpu (-1 if not pinned)
+  int  node;  // NUMA node of cpuId
+  CPUProfile *prof; // Cycle accounting (-profile), NULL if off
 
 #ifdef WITHGPU
   int  gridSizeX;
@@ -79,9 +92,6 @@ typedef struct {
   Int *px; // Kangaroo position
   Int *py; // Kangaroo position
   Int *distance; // Travelled distance
-#ifdef USE_SYMMETRY
-  uint64_t *symClass; // Last jump
-#endif
   
   SOCKET clientSock;
   char  *clientInfo;
@@ -91,9 +101,21 @@ typedef struct {
   char *part1Name;
   char *part2Name;
 
+  SPSCQueue<ITEM> *dpQueue;       // DP found by the walker, drained by the flush thread
+  SPSCQueue<uint64_t> *deadQueue; // Kangaroo to reset (collision in same herd)
+
+  int *mkSlotKey;   // Multi-key: wild slot to key map the herd was built with (written under ghMutex)
+  uint32_t mkEpoch; // Multi-key: epoch of mkSlotKey
+
 } TH_PARAM;
 
 
+// Per thread step counter, one cache line each (no false sharing)
+typedef struct alignas(64) {
+  uint64_t count;
+  uint8_t pad[56];
+} COUNTER;
+
 // DP transfered over the network
 typedef struct {
 
@@ -124,6 +146,9 @@ typedef struct {
 #define HEADK  0xFA6A8002  // Kangaroo only file
 #define HEADKS 0xFA6A8003  // Compressed Kangaroo only file
 
+// Work file version flags
+#define WORK_SYM 0x1  // Symmetric walk (negation map)
+
 // Number of Hash entry per partition
 #define H_PER_PART (HASH_SIZE / MERGE_PART)
 
@@ -133,9 +158,12 @@ public:
 
   Kangaroo(Secp256K1 *secp,int32_t initDPSize,bool useGpu,std::string &workFile,std::string &iWorkFile,
            uint32_t savePeriod,bool saveKangaroo,bool saveKangarooByServer,double maxStep,int wtimeout,int sport,int ntimeout,
-           std::string serverIp,std::string outputFile,bool splitWorkfile,std::string &workTextFile,bool saveKangarooText);
+           std::string serverIp,std::string outputFile,bool splitWorkfile,std::string &workTextFile,bool saveKangarooText,
+           int cpuEngine,bool affinity,bool symmetry,bool autoTune,double ramBudget,bool fastSeed,
+           bool profile,std::string ctlFile,bool multiKey,std::string tameDBFile,uint64_t tameDBBuild,
+           int method,bool gaudrySchost,int bsgsMode);
   void Run(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize);
-  void RunServer();
+  void RunServer(int nbThread);
   bool ParseConfigFile(std::string &fileName);
   bool LoadWork(std::string &fileName);
   void Check(std::vector<int> gpuId,std::vector<int> gridSize);
@@ -157,7 +185,9 @@ public:
   bool CheckPartition(TH_PARAM* p);
   bool CheckWorkFile(TH_PARAM* p);
   void ProcessServer();
+  void StartServerWalkers(int nbThread);
   void ScanGapsThread(TH_PARAM *p);
+  void FlushDPThread(TH_PARAM *p);
 
   void AddConnectedClient();
   void RemoveConnectedClient();
@@ -167,18 +197,33 @@ private:
 
   bool IsDP(Int *x);
   void SetDP(int size);
-  void CreateHerd(int nbKangaroo,Int *px, Int *py, Int *d, int firstType,bool lock=true);
+  void CreateHerd(int nbKangaroo,Int *px, Int *py, Int *d, int firstType,uint64_t *kIdx=NULL,int thId=0);
+  double CreateHerds(uint64_t nbKangaroo,Int *px,Int *py,Int *d);
+  void SeedHerd(int nbKangaroo,Int *d,int firstType,std::vector<Point> &S);
+  void RespawnKangaroos(int thId,std::vector<uint64_t> &kIdx,std::vector<Int> &px,std::vector<Int> &py,std::vector<Int> &d);
   void CreateJumpTable();
   bool AddToTable(uint64_t h,int256_t *x,int256_t *d);
   bool AddToTable(int256_t *x,int256_t *d, uint32_t kType);
   bool AddToTable(uint64_t h, int256_t *x,int256_t *d, uint32_t kType);
   bool AddToTable(Int *pos,Int *dist, uint32_t kType);
+  bool CheckTameDB(int256_t *x,Int *dist,uint32_t kType);
   bool SendToServer(std::vector<ITEM> &dp,uint32_t threadId,uint32_t gpuId);
+  void PushDP(TH_PARAM *ph,std::vector<ITEM> &dp);
+  uint32_t FlushDP();
   bool CheckKey(Int d1,Int d2,uint8_t type);
+  bool CheckKeyHalf(Int d1,Int d2);
   bool CollisionCheck(Int* d1, uint32_t type1,Int* d2, uint32_t type2);
-  void ComputeExpected(double dp,double *op,double *ram,double* overHead = NULL);
+  void ComputeExpected(double dp,double *op,double *ram,double* overHead = NULL,bool other = false);
+  int SuggestDP(bool other,double *cost);
   void InitRange();
   void InitSearchKey();
+  void InitMultiKey();
+  void SelectKey(int k);
+  int GetWildKey(int thId,uint64_t kIdx);
+  int GetHerd(uint64_t idx);
+  uint32_t GetKType(int thId,uint64_t kIdx);
+  bool CheckMultiKey(Int *Td,Int *Wd,uint32_t wType);
+  void ResyncMultiKey(TH_PARAM *ph,std::vector<uint64_t> &dead);
   std::string GetTimeStr(double s);
   bool Output(Int* pk,char sInfo,int sType);
 
@@ -201,6 +246,23 @@ private:
   static std::string GetPartName(std::string& partName,int i,bool tmpPart);
   static FILE* OpenPart(std::string& partName,const char* mode,int i,bool tmpPart=false);
   uint32_t CheckHash(uint32_t h,uint32_t nbItem,HashTable* hT,FILE* f);
+  double CPUEngineRate(int type,double duration);
+  double CPUHerdRate(int nbThread,double duration);
+  double TableRate();
+  void AutoTune(int *nbThread);
+  int AutoTuneDP();
+  bool LoadTune(int maxThread,bool narrow,int *grpSize,int *nbThread);
+  void SaveTune(int maxThread,bool narrow,int grpSize,int nbThread);
+  bool CheckCPUEngine(int type,int nbStep);
+  bool CheckHerd(int nb,bool fast);
+  bool CheckHashTable();
+  static double GetPhysicalRAM();
+
+  // Baby-step giant-step
+  bool SelectBSGS(uint64_t *nbBaby);
+  void SolveBSGS(uint64_t nbBaby);
+  double BSGSRate(double duration);
+  bool CheckBSGS(Int *c,Int *j,Point &Q);
 
 
   // Network stuff
@@ -234,15 +296,26 @@ private:
 
   uint64_t getCPUCount();
   uint64_t getGPUCount();
+  double getWalkStats(TH_PARAM *params,uint64_t *hist,uint64_t *stuck);
+  void PrintWalkStats(TH_PARAM *params);
+  void PrintProfile(TH_PARAM *params);
+  int ReadCtlFile();
+  void ScaleCPU(TH_PARAM *params);
+  void StartCPUWorker(TH_PARAM *params,int i);
+  void StopCPUWorker(TH_PARAM *params,int i);
   bool isAlive(TH_PARAM *p);
   bool hasStarted(TH_PARAM *p);
   bool isWaiting(TH_PARAM *p);
 
   Secp256K1 *secp;
   HashTable hashTable;
-  uint64_t counters[256];
-  int  nbCPUThread;
+  COUNTER counters[256];
+  int  nbCPUThread; // CPU slots (walkers, running or parked)
+  int  nbCPUActive; // Running CPU walkers
   int  nbGPUThread;
+  TH_PARAM *walkers;
+  THREAD_HANDLE *walkerHandles;
+  std::string ctlFile; // Elastic scaling control file (-ctl)
   double startTime;
 
   std::mutex asyncSaveThreadMutex;
@@ -271,6 +344,22 @@ private:
   Point keyToSearch;
   Point keyToSearchNeg;
   uint32_t keyIdx;
+  std::vector<Int> keyStart; // Per key range start (config file), empty if none
+
+  // Multi-key (-multikey): one tame herd for all the keys, wild kangaroos
+  // are spread over the keys by slot and carry their key in the DP type
+  bool multiKey;
+  std::vector<Point> mkKey;  // Translated keys
+  std::vector<bool> mkSolved;
+  int *mkSlotKey;            // Wild slot to key, solved slots move to unsolved keys (ghMutex)
+  std::atomic<uint32_t> mkEpoch;
+  int mkNbSolved;
+
+  // Precomputed tame DP (-tdb): built by tame only walks (-tdbbuild),
+  // or searched by wild only walks
+  std::string tameDBFile;
+  uint64_t tameDBBuild;
+  TameDB *tameDB;
   bool endOfSearch;
   bool useGpu;
   double expectedNbOp;
@@ -281,8 +370,27 @@ private:
   Int jumpDistance[NB_JUMP];
   Int jumpPointx[NB_JUMP];
   Int jumpPointy[NB_JUMP];
+  Int escapeDistance;
+  Int escapePointx;
+  Int escapePointy;
+  bool symmetry;
+  int method; // Number of herds: 2 (tame/wild) or 4 (Galbraith-Pollard-Ruprai)
+  bool gaudrySchost; // Walks restarted at random after each DP (-gs)
+  int bsgsMode; // BSGS_AUTO, BSGS_ON (-bsgs) or BSGS_OFF (-nobsgs)
+  bool fastSeed;
+  bool profile;
 
   int CPU_GRP_SIZE;
+  int cpuEngine;
+  double cpuScalarRate;
+  bool affinity;
+  int nbNode;
+
+  // Autotune (-autotune), measured rates and RAM budget (MB)
+  bool autoTune;
+  double ramBudget;
+  double tuneRate;
+  double tuneDPRate;
 
   // Backup stuff
   std::string outputFile;
@@ -111,6 +111,7 @@ bool Kangaroo::MergeWork(std::string& file1,std::string& file2,std::string& dest
     fclose(f2);
     return true;
   }
+  symmetry = (v1 & WORK_SYM) != 0;
 
   k2.z.SetInt32(1);
   if(!secp->EC(k2)) {
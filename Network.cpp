@@ -43,7 +43,7 @@ static SOCKET serverSock = 0;
 #define WAIT_FOR_READ  1
 #define WAIT_FOR_WRITE 2
 
-#define SERVER_VERSION 3
+#define SERVER_VERSION 4
 
 #define SERVER_HEADER 0x67DEDDC1
 
@@ -282,6 +282,7 @@ bool Kangaroo::HandleRequest(TH_PARAM *p) {
 
   char cmdBuff;
   uint32_t version = SERVER_VERSION;
+  uint32_t sym = symmetry ? 1 : 0;
   int nbRead;
   int nbWrite;
   int32_t state;
@@ -308,6 +309,7 @@ bool Kangaroo::HandleRequest(TH_PARAM *p) {
       PUT("KeyX",p->clientSock,keysToSearch[keyIdx].x.bits64,32,ntimeout);
       PUT("KeyY",p->clientSock,keysToSearch[keyIdx].y.bits64,32,ntimeout);
       PUT("DP",p->clientSock,&initDPSize,sizeof(int32_t),ntimeout);
+      PUT("Symmetry",p->clientSock,&sym,sizeof(uint32_t),ntimeout);
 
     } break;
 
@@ -639,8 +641,8 @@ DWORD WINAPI _processServer(LPVOID lpParam) {
 #else
 void *_processServer(void *lpParam) {
 #endif
-  Kangaroo *obj = (Kangaroo *)lpParam;
-  obj->ProcessServer();
+  TH_PARAM *p = (TH_PARAM *)lpParam;
+  p->obj->ProcessServer();
   return 0;
 }
 
@@ -683,7 +685,7 @@ void Kangaroo::AcceptConnections(SOCKET server_soc) {
 }
 
 // Starts the server
-void Kangaroo::RunServer() {
+void Kangaroo::RunServer(int nbThread) {
 
   if(signal(SIGINT,sig_handler) == SIG_ERR)
     ::printf("\nWarning:can't install singal handler\n");
@@ -712,13 +714,19 @@ void Kangaroo::RunServer() {
     exit(-1);
   }
 
-  if(saveKangaroo) {
+  if(saveKangaroo && nbThread == 0) {
     ::printf("Waring: Server does not support -ws, ignoring\n");
     saveKangaroo = false;
   }
 
+  // Hybrid server, local walkers write to the table without socket
+  if(nbThread > 0)
+    StartServerWalkers(nbThread);
+
   // Main thread of server (handle backup and collision check)
-  LaunchThread(_processServer,(TH_PARAM *)this);
+  TH_PARAM *sp = (TH_PARAM *)malloc(sizeof(TH_PARAM));
+  ::memset(sp,0,sizeof(TH_PARAM));
+  LaunchThread(_processServer,sp);
   Timer::SleepMillis(100);
 
   // Server stuff
@@ -1246,13 +1254,17 @@ bool Kangaroo::GetConfigFromServer() {
   GET("KeyY",serverConn,key.y.bits64,32,ntimeout);
   GET("DP",serverConn,&initDPSize,sizeof(int32_t),ntimeout);
 
-  if(version<3) {
+  if(version<4) {
     isConnected = false;
     close_socket(serverConn);
-    ::printf("Cannot connect to server: %s\nServer version must be >= 3\n",serverIp.c_str());
+    ::printf("Cannot connect to server: %s\nServer version must be >= 4\n",serverIp.c_str());
     return false;
   }
 
+  uint32_t sym;
+  GET("Symmetry",serverConn,&sym,sizeof(uint32_t),ntimeout);
+  symmetry = (sym != 0);
+
   // Set kangaroo number
   cmd = SERVER_SETKNB;
   PUT("CMD",serverConn,&cmd,1,ntimeout);
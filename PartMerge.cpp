@@ -258,6 +258,7 @@ bool Kangaroo::MergeWorkPartPart(std::string& part1Name,std::string& part2Name)
       ::fclose(f1);
       return true;
     }
+    symmetry = (v1 & WORK_SYM) != 0;
 
     k1.z.SetInt32(1);
     if(!secp->EC(k1)) {
@@ -480,6 +481,7 @@ bool Kangaroo::FillEmptyPartFromFile(std::string& partName,std::string& fileName
     ::fclose(f1);
     return true;
   }
+  symmetry = (v1 & WORK_SYM) != 0;
 
   k1.z.SetInt32(1);
   if(!secp->EC(k1)) {
@@ -654,6 +656,7 @@ bool Kangaroo::MergeWorkPart(std::string& partName,std::string& file2,bool print
     SafeClose(f2);
     return true;
   }
+  symmetry = (v1 & WORK_SYM) != 0;
 
   if(!RS1.IsEqual(&RS2) || !RE1.IsEqual(&RE2)) {
 
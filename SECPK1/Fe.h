@@ -0,0 +1,156 @@
+/*
+ * This file is part of the BSGS distribution (https://github.com/JeanLucPons/Kangaroo).
+ * Copyright (c) 2020 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FEH
+#define FEH
+
+#include "Int.h"
+
+// SecpK1 field characteristic
+inline constexpr uint64_t FE_P[4] = {
+  0xFFFFFFFEFFFFFC2FULL,0xFFFFFFFFFFFFFFFFULL,0xFFFFFFFFFFFFFFFFULL,0xFFFFFFFFFFFFFFFFULL
+};
+
+// SecpK1 field element, 4x64 bits (32 bytes) without the spare limb of
+// Int, for the hot path. Conversions from/to Int are explicit (Set/Get).
+// Like the Int K1 functions, results are congruent mod p and lower
+// than 2^256 but not always fully reduced.
+class alignas(32) Fe {
+
+public:
+
+  inline void Set(const Fe *a) {
+    v[0] = a->v[0];
+    v[1] = a->v[1];
+    v[2] = a->v[2];
+    v[3] = a->v[3];
+  }
+
+  inline void Set(const Int *a) {
+    v[0] = a->bits64[0];
+    v[1] = a->bits64[1];
+    v[2] = a->bits64[2];
+    v[3] = a->bits64[3];
+  }
+
+  inline void Get(Int *r) const {
+    r->bits64[0] = v[0];
+    r->bits64[1] = v[1];
+    r->bits64[2] = v[2];
+    r->bits64[3] = v[3];
+    r->bits64[4] = 0;
+#if NB64BLOCK > 5
+    for(int i = 5; i < NB64BLOCK; i++)
+      r->bits64[i] = 0;
+#endif
+  }
+
+  inline void SetInt32(uint32_t a) {
+    v[0] = a;
+    v[1] = 0;
+    v[2] = 0;
+    v[3] = 0;
+  }
+
+  inline bool IsZero() const {
+    return (v[0] | v[1] | v[2] | v[3]) == 0;
+  }
+
+  inline bool IsEqual(const Fe *a) const {
+    return ((v[0] ^ a->v[0]) | (v[1] ^ a->v[1]) | (v[2] ^ a->v[2]) | (v[3] ^ a->v[3])) == 0;
+  }
+
+  // this <- a - b (mod p)
+  inline void ModSubK1(const Fe *a,const Fe *b) {
+    unsigned char c;
+    c = _subborrow_u64(0,a->v[0],b->v[0],v + 0);
+    c = _subborrow_u64(c,a->v[1],b->v[1],v + 1);
+    c = _subborrow_u64(c,a->v[2],b->v[2],v + 2);
+    c = _subborrow_u64(c,a->v[3],b->v[3],v + 3);
+    // Add p on borrow
+    uint64_t m = 0ULL - (uint64_t)c;
+    c = _addcarry_u64(0,v[0],FE_P[0] & m,v + 0);
+    c = _addcarry_u64(c,v[1],FE_P[1] & m,v + 1);
+    c = _addcarry_u64(c,v[2],FE_P[2] & m,v + 2);
+    c = _addcarry_u64(c,v[3],FE_P[3] & m,v + 3);
+  }
+
+  // this <- this - a (mod p)
+  inline void ModSubK1(const Fe *a) {
+    ModSubK1(this,a);
+  }
+
+  // this <- a + b (mod p)
+  inline void ModAddK1(const Fe *a,const Fe *b) {
+    unsigned char c;
+    uint64_t s[4];
+    uint64_t t[4];
+    uint64_t cy;
+    c = _addcarry_u64(0,a->v[0],b->v[0],s + 0);
+    c = _addcarry_u64(c,a->v[1],b->v[1],s + 1);
+    c = _addcarry_u64(c,a->v[2],b->v[2],s + 2);
+    c = _addcarry_u64(c,a->v[3],b->v[3],s + 3);
+    cy = c;
+    c = _subborrow_u64(0,s[0],FE_P[0],t + 0);
+    c = _subborrow_u64(c,s[1],FE_P[1],t + 1);
+    c = _subborrow_u64(c,s[2],FE_P[2],t + 2);
+    c = _subborrow_u64(c,s[3],FE_P[3],t + 3);
+    c = _subborrow_u64(c,cy,0ULL,&cy);
+    // Keep a + b when a + b < p
+    uint64_t m = 0ULL - (uint64_t)c;
+    v[0] = (s[0] & m) | (t[0] & ~m);
+    v[1] = (s[1] & m) | (t[1] & ~m);
+    v[2] = (s[2] & m) | (t[2] & ~m);
+    v[3] = (s[3] & m) | (t[3] & ~m);
+  }
+
+  // this <- -this (mod p)
+  inline void ModNegK1() {
+    unsigned char c;
+    c = _subborrow_u64(0,FE_P[0],v[0],v + 0);
+    c = _subborrow_u64(c,FE_P[1],v[1],v + 1);
+    c = _subborrow_u64(c,FE_P[2],v[2],v + 2);
+    c = _subborrow_u64(c,FE_P[3],v[3],v + 3);
+  }
+
+  // Set this to min(this,-this), return 1 if negated (see Int::ModPositiveK1)
+  inline uint32_t ModPositiveK1() {
+    Fe n;
+    uint64_t t;
+    unsigned char c;
+    n.Set(this);
+    n.ModNegK1();
+    c = _subborrow_u64(0,v[0],n.v[0],&t);
+    c = _subborrow_u64(c,v[1],n.v[1],&t);
+    c = _subborrow_u64(c,v[2],n.v[2],&t);
+    c = _subborrow_u64(c,v[3],n.v[3],&t);
+    if(c)
+      return 0;
+    Set(&n);
+    return 1;
+  }
+
+  void ModMulK1(const Fe *a,const Fe *b);  // this <- a*b (mod p)
+  void ModMulK1(const Fe *a);              // this <- this*a (mod p)
+  void ModSquareK1(const Fe *a);           // this <- a^2 (mod p)
+  void ModInv();                           // this <- 1/this (mod p)
+
+  uint64_t v[4];
+
+};
+
+#endif // FEH
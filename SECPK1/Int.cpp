@@ -17,6 +17,7 @@
 
 #include "Int.h"
 #include "IntGroup.h"
+#include "Fe.h"
 #include <string.h>
 #include <cstdio>
 #include <math.h>
@@ -727,7 +728,7 @@ void Int::ShiftL(uint32_t n) {
     uint32_t nb64 = n/64;
     uint32_t nb   = n%64;
     for(uint32_t i=0;i<nb64;i++) ShiftL64Bit();
-	  shiftL((unsigned char)nb, bits64);
+    if(nb) shiftL((unsigned char)nb, bits64);
   }
   
 }
@@ -773,7 +774,7 @@ void Int::ShiftR(uint32_t n) {
     uint32_t nb64 = n/64;
     uint32_t nb   = n%64;
     for(uint32_t i=0;i<nb64;i++) ShiftR64Bit();
-	  shiftR((unsigned char)nb, bits64);
+    if(nb) shiftR((unsigned char)nb, bits64);
   }
   
 }
@@ -1028,6 +1029,21 @@ void Int::Rand(int nbit) {
 
 // ------------------------------------------------
 
+void Int::RandQ(int nbit) {
+
+  CLEAR();
+
+  int nb = nbit / 64;
+  int i = 0;
+  for(; i < nb; i++)
+    bits64[i] = rndq();
+  if(nbit % 64)
+    bits64[i] = rndq() & ((1ULL << (nbit % 64)) - 1);
+
+}
+
+// ------------------------------------------------
+
 void Int::Rand(Int *randMax) {
 
   int b = randMax->GetBitLength();
@@ -1745,6 +1761,46 @@ void Int::Check() {
     printf("IntGroup.ModInv() Results OK : ");
     Timer::printResult("Inv",1000 * 256,0,t1 - t0);
 
+    // Single chain, interleaved chains and multithreaded batches (Fe),
+    // the last one on 4 threads whatever the number of core
+    int gSize[4] = { 3,IG_CHAIN_MIN + 1,IG_PARALLEL_MIN + 5,IG_PARALLEL_MIN + 5 };
+    double tg = 0.0;
+    for(int s = 0; s < 4; s++) {
+      int n = gSize[s];
+      if(s == 3) IntGroup::SetNbThread(4);
+      Fe *fm = new Fe[n];
+      Int *fChk = new Int[n];
+      IntGroup fg(n);
+      fg.Set(fm);
+      for(int i = 0; i < n; i++) {
+        fChk[i].Rand(pSize);
+        fm[i].Set(fChk + i);
+        fChk[i].ModInv();
+      }
+      t0 = Timer::get_tick();
+      fg.ModInv();
+      t1 = Timer::get_tick();
+      if(s == 2) tg = t1 - t0;
+      IntGroup::SetNbThread(0);
+      for(int i = 0; i < n; i++) {
+        Int r;
+        fm[i].Get(&r);
+        if(r.IsGreaterOrEqual(&b)) r.Sub(&b);
+        if(!r.IsEqual(fChk + i)) {
+          printf("IntGroup.ModInv(Fe,%d) Wrong !\n",n);
+          printf("[%d] %s\n",i,r.GetBase16().c_str());
+          printf("[%d] %s\n",i,fChk[i].GetBase16().c_str());
+          delete[] fm;
+          delete[] fChk;
+          return;
+        }
+      }
+      delete[] fm;
+      delete[] fChk;
+    }
+    printf("IntGroup.ModInv(Fe) Results OK : %d inverses in %.3f ms (%d thread(s))\n",IG_PARALLEL_MIN + 5,
+           tg * 1000.0,IntGroup::GetNbThread());
+
     // ModMulK1 ------------------------------------------------------------------------------------
 
     for(int i = 0; i < 100000; i++) {
@@ -1835,10 +1891,118 @@ void Int::Check() {
     printf("ModMulK1order() Results OK : ");
     Timer::printResult("Mult",1000000,0,t1 - t0);
 
+    // BMI2/ADX kernels against the portable ones -------------------------------------------------
+
+    if(Int::SetK1Kernel(true)) {
+
+      Int P;
+      Int N;
+      P.SetBase16("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFC2F");
+      N.SetBase16("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEBAAEDCE6AF48A03BBFD25E8CD0364141");
+      Int r[4];
+      Int x[4];
+
+      // Edge cases: 0, 1, n-1, n-2
+      Int edge[4];
+      edge[0].SetInt32(0);
+      edge[1].SetInt32(1);
+      edge[2].Set(&N); edge[2].Sub(1);
+      edge[3].Set(&N); edge[3].Sub(2);
+
+      for(int i = 0; i < 100000; i++) {
+        if(i < 16) {
+          a.Set(&edge[i % 4]);
+          b.Set(&edge[i / 4]);
+        } else {
+          a.Rand(256);
+          b.Rand(256);
+          a.Mod(&N);
+          b.Mod(&N);
+        }
+        for(int k = 0; k < 2; k++) {
+          Int::SetK1Kernel(k == 1);
+          Int *o = (k == 0) ? r : x;
+          o[0].ModMulK1(&a,&b);
+          o[1].ModSquareK1(&a);
+          o[2].ModAddK1order(&a,&b);
+          o[3].Set(&a);
+          o[3].ModSubK1order(&b);
+        }
+        for(int k = 0; k < 4; k++) {
+          if(!r[k].IsEqual(&x[k])) {
+            const char *name[] = { "ModMulK1","ModSquareK1","ModAddK1order","ModSubK1order" };
+            printf("%s() BMI2/ADX Wrong !\n",name[k]);
+            printf("[%d] %s\n",i,r[k].GetBase16().c_str());
+            printf("[%d] %s\n",i,x[k].GetBase16().c_str());
+            return;
+          }
+        }
+      }
+
+      double tK[2];
+      for(int k = 0; k < 2; k++) {
+        Int::SetK1Kernel(k == 1);
+        a.Rand(&P);
+        b.Rand(&P);
+        t0 = Timer::get_tick();
+        for(int i = 0; i < 1000000; i++) {
+          a.ModMulK1(&b);
+          b.ModSquareK1(&a);
+        }
+        tK[k] = Timer::get_tick() - t0;
+      }
+
+      printf("BMI2/ADX kernels Results OK : %.3f MegaMulSqr/sec (x%.2f)\n",1.0 / tK[1],tK[0] / tK[1]);
+
+    } else {
+
+      printf("BMI2/ADX kernels not supported\n");
+
+    }
+
   }
 
   // Restore Secp256K1 prime
   b.SetBase16("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFC2F");
   Int::SetupField(&b);
 
+  // Fe (4 limbs) against Int, with both kernels ------------------------------------------------
+
+  bool mulx = Int::IsK1Mulx();
+  for(int k = 0; k < 2; k++) {
+
+    if(!Int::SetK1Kernel(k == 1))
+      continue;
+
+    Fe fa,fb,fr;
+    for(int i = 0; i < 100000; i++) {
+      a.Rand(&b);
+      c.Rand(&b);
+      fa.Set(&a);
+      fb.Set(&c);
+      const char *op = NULL;
+      d.ModMulK1(&a,&c); fr.ModMulK1(&fa,&fb); fr.Get(&e);
+      if(!d.IsEqual(&e)) op = "ModMulK1";
+      d.ModSquareK1(&a); fr.ModSquareK1(&fa); fr.Get(&e);
+      if(!d.IsEqual(&e)) op = "ModSquareK1";
+      d.ModSub(&a,&c); fr.ModSubK1(&fa,&fb); fr.Get(&e);
+      if(!d.IsEqual(&e)) op = "ModSubK1";
+      d.ModAdd(&a,&c); fr.ModAddK1(&fa,&fb); fr.Get(&e);
+      if(!d.IsEqual(&e)) op = "ModAddK1";
+      d.Set(&a); d.ModPositiveK1(); fr.Set(&fa); fr.ModPositiveK1(); fr.Get(&e);
+      if(!d.IsEqual(&e)) op = "ModPositiveK1";
+      if(op) {
+        printf("Fe::%s() Wrong !\n",op);
+        printf("[%d] %s\n",i,d.GetBase16().c_str());
+        printf("[%d] %s\n",i,e.GetBase16().c_str());
+        Int::SetK1Kernel(mulx);
+        return;
+      }
+    }
+
+    printf("Fe %s Results OK\n",(k == 1) ? "BMI2/ADX" : "portable");
+
+  }
+  Int::SetK1Kernel(mulx);
+
 }
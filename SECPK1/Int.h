@@ -133,6 +133,8 @@ public:
 
   // Specific SecpK1
   static void InitK1(Int *order);
+  static bool SetK1Kernel(bool mulx);       // Select BMI2/ADX kernels, false if not supported
+  static bool IsK1Mulx();
   void ModMulK1(Int *a, Int *b);
   void ModMulK1(Int *a);
   void ModSquareK1(Int *a);
@@ -159,6 +161,7 @@ public:
   void SetQWord(int n,uint64_t b);
   void Rand(int nbit);
   void Rand(Int *randMax);
+  void RandQ(int nbit);        // From the per thread stream (rndq)
   void Set32Bytes(unsigned char *bytes);
   void MaskByte(int n);
 
@@ -16,43 +16,145 @@
 */
 
 #include "IntGroup.h"
+#include <thread>
 
 using namespace std;
 
+thread_local int IntGroup::nbThread = 0;
+
 IntGroup::IntGroup(int size) {
   this->size = size;
   subp = (Int *)malloc(size * sizeof(Int));
+  subpFe = NULL;
+  ints = NULL;
+  fes = NULL;
 }
 
 IntGroup::~IntGroup() {
   free(subp);
+  delete[] subpFe;
 }
 
 void IntGroup::Set(Int *pts) {
   ints = pts;
+  fes = NULL;
 }
 
-// Compute modular inversion of the whole group
-void IntGroup::ModInv() {
+void IntGroup::Set(Fe *pts) {
+  if(subpFe == NULL)
+    subpFe = new Fe[size];
+  fes = pts;
+  ints = NULL;
+}
+
+void IntGroup::SetNbThread(int nbThread) {
+  IntGroup::nbThread = nbThread;
+}
+
+int IntGroup::GetNbThread() {
+  if(nbThread > 0)
+    return nbThread;
+  int nb = (int)std::thread::hardware_concurrency();
+  return (nb > 0) ? nb : 1;
+}
+
+// ------------------------------------------------------------------------------------------
 
-  Int newValue;
-  Int inverse;
+// Prefix products of n values on depth interleaved chains (v[i] belongs to
+// chain i % depth), prod[c] is the product of chain c
+template <class T>
+static void ChainProd(T *v,T *subp,int n,int depth,T *prod) {
 
-  subp[0].Set(&ints[0]);
-  for (int i = 1; i < size; i++) {
-    subp[i].ModMulK1(&subp[i - 1], &ints[i]);
+  for(int i = 0; i < depth; i++)
+    subp[i].Set(&v[i]);
+  for(int i = depth; i < n; i++)
+    subp[i].ModMulK1(&subp[i - depth],&v[i]);
+  for(int i = n - depth; i < n; i++)
+    prod[i % depth].Set(&subp[i]);
+
+}
+
+// Back substitution, inv[c] is the inverse of the chain c product
+template <class T>
+static void ChainBack(T *v,T *subp,int n,int depth,T *inv) {
+
+  T newValue;
+  for(int i = n - 1; i >= depth; i--) {
+    T *cInv = &inv[i % depth];
+    newValue.ModMulK1(&subp[i - depth],cInv);
+    cInv->ModMulK1(&v[i]);
+    v[i].Set(&newValue);
   }
+  for(int i = 0; i < depth; i++)
+    v[i].Set(&inv[i]);
 
-  // Do the inversion
-  inverse.Set(&subp[size - 1]);
+}
+
+// Serial batch inversion of a few values
+template <class T>
+static void SmallInv(T *v,T *subp,int n) {
+
+  T inverse;
+  ChainProd(v,subp,n,1,&inverse);
   inverse.ModInv();
+  ChainBack(v,subp,n,1,&inverse);
+
+}
+
+template <class T>
+static void GroupInv(T *v,T *subp,int n) {
+
+  int nbThread = (n >= IG_PARALLEL_MIN) ? IntGroup::GetNbThread() : 1;
+  if(nbThread > n / (IG_PARALLEL_MIN / 4))
+    nbThread = n / (IG_PARALLEL_MIN / 4);
+
+  if(nbThread <= 1) {
+
+    // Interleaved chains, their products are inverted together
+    int depth = (n >= IG_CHAIN_MIN) ? IG_CHAIN : 1;
+    T inv[IG_CHAIN];
+    T tmp[IG_CHAIN];
+    ChainProd(v,subp,n,depth,inv);
+    SmallInv(inv,tmp,depth);
+    ChainBack(v,subp,n,depth,inv);
+    return;
 
-  for (int i = size - 1; i > 0; i--) {
-    newValue.ModMulK1(&subp[i - 1], &inverse);
-    inverse.ModMulK1(&ints[i]);
-    ints[i].Set(&newValue);
   }
 
-  ints[0].Set(&inverse);
+  // Contiguous blocks, one per thread, and a single inversion of all the
+  // chain products
+  vector<T> inv(nbThread * IG_CHAIN);
+  vector<T> tmp(nbThread * IG_CHAIN);
+  vector<std::thread> th;
+  int blockSize = (n + nbThread - 1) / nbThread;
 
-}
\ No newline at end of file
+  for(int t = 0; t < nbThread; t++) {
+    int start = t * blockSize;
+    int nb = (n - start < blockSize) ? n - start : blockSize;
+    th.push_back(std::thread(ChainProd<T>,v + start,subp + start,nb,IG_CHAIN,&inv[t * IG_CHAIN]));
+  }
+  for(int t = 0; t < nbThread; t++)
+    th[t].join();
+
+  SmallInv(inv.data(),tmp.data(),nbThread * IG_CHAIN);
+
+  th.clear();
+  for(int t = 0; t < nbThread; t++) {
+    int start = t * blockSize;
+    int nb = (n - start < blockSize) ? n - start : blockSize;
+    th.push_back(std::thread(ChainBack<T>,v + start,subp + start,nb,IG_CHAIN,&inv[t * IG_CHAIN]));
+  }
+  for(int t = 0; t < nbThread; t++)
+    th[t].join();
+
+}
+
+// Compute modular inversion of the whole group
+void IntGroup::ModInv() {
+
+  if(fes)
+    GroupInv(fes,subpFe,size);
+  else
+    GroupInv(ints,subp,size);
+
+}
@@ -19,8 +19,17 @@
 #define INTGROUPH
 
 #include "Int.h"
+#include "Fe.h"
 #include <vector>
 
+// Number of interleaved prefix product chains, independent multiplications
+// in flight during the batch inversion (from IG_CHAIN_MIN elements)
+#define IG_CHAIN 4
+#define IG_CHAIN_MIN 16
+
+// From this size, the batch is split over several threads
+#define IG_PARALLEL_MIN 65536
+
 class IntGroup {
 
 public:
@@ -28,13 +37,21 @@ public:
 	IntGroup(int size);
 	~IntGroup();
 	void Set(Int *pts);
+	void Set(Fe *pts);
 	void ModInv();
 
+  // Max number of thread for large batches (0: all cores), per calling thread
+  static void SetNbThread(int nbThread);
+  static int GetNbThread();
+
 private:
 
 	Int *ints;
   Int *subp;
+  Fe *fes;
+  Fe *subpFe;
   int size;
+  static thread_local int nbThread;
 
 };
 
@@ -16,6 +16,7 @@
 */
 
 #include "Int.h"
+#include "Fe.h"
 #if defined(__x86_64__) || defined(_M_X64) || defined(__i386) || defined(_M_IX86)
 #include <emmintrin.h>
 #endif
@@ -869,8 +870,447 @@ void Int::MontgomeryMult(Int *a, Int *b) {
 
 // SecpK1 specific section -----------------------------------------------------------------------------
 
+#if BISIZE==256 && defined(__x86_64__) && !defined(_MSC_VER)
+
+// BMI2/ADX kernels: mulx and dual (adcx/adox) carry chains, selected at
+// startup with cpuid. The generic code below remains the portable fallback.
+#define K1_MULX
+#include <cpuid.h>
+
+// SecpK1 order
+static const uint64_t _K1N[4] = {
+  0xBFD25E8CD0364141ULL,0xBAAEDCE6AF48A03BULL,0xFFFFFFFFFFFFFFFEULL,0xFFFFFFFFFFFFFFFFULL
+};
+
+static bool K1MulxSupported() {
+  unsigned int eax,ebx,ecx,edx;
+  if(!__get_cpuid_count(7,0,&eax,&ebx,&ecx,&edx))
+    return false;
+  // BMI2 (mulx) and ADX (adcx/adox)
+  return (ebx & (1U << 8)) && (ebx & (1U << 19));
+}
+
+// r = a*b mod p (r may alias a or b)
+static void ModMulK1X(uint64_t *r,const uint64_t *a,const uint64_t *b) {
+
+  uint64_t l0,l1,l2,l3,l4,t0,t1,z;
+  uint64_t m[3];
+
+  __asm__ volatile (
+    // Row 0
+    "movq 0(%[b]),%%rdx\n\t"
+    "mulxq 0(%[a]),%[l0],%[l1]\n\t"
+    "mulxq 8(%[a]),%[t0],%[l2]\n\t"
+    "addq %[t0],%[l1]\n\t"
+    "mulxq 16(%[a]),%[t0],%[l3]\n\t"
+    "adcq %[t0],%[l2]\n\t"
+    "mulxq 24(%[a]),%[t0],%[l4]\n\t"
+    "adcq %[t0],%[l3]\n\t"
+    "adcq $0,%[l4]\n\t"
+    "movq %[l0],%[m0]\n\t"
+    // Row 1 (r1..r4 in l1..l4, r5 in l0)
+    "xorl %k[z],%k[z]\n\t"
+    "movq 8(%[b]),%%rdx\n\t"
+    "mulxq 0(%[a]),%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l1]\n\t"
+    "adoxq %[t1],%[l2]\n\t"
+    "mulxq 8(%[a]),%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l2]\n\t"
+    "adoxq %[t1],%[l3]\n\t"
+    "mulxq 16(%[a]),%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l3]\n\t"
+    "adoxq %[t1],%[l4]\n\t"
+    "mulxq 24(%[a]),%[t0],%[l0]\n\t"
+    "adcxq %[t0],%[l4]\n\t"
+    "adoxq %[z],%[l0]\n\t"
+    "adcxq %[z],%[l0]\n\t"
+    "movq %[l1],%[m1]\n\t"
+    // Row 2 (r2..r5 in l2,l3,l4,l0, r6 in l1)
+    "xorl %k[z],%k[z]\n\t"
+    "movq 16(%[b]),%%rdx\n\t"
+    "mulxq 0(%[a]),%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l2]\n\t"
+    "adoxq %[t1],%[l3]\n\t"
+    "mulxq 8(%[a]),%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l3]\n\t"
+    "adoxq %[t1],%[l4]\n\t"
+    "mulxq 16(%[a]),%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l4]\n\t"
+    "adoxq %[t1],%[l0]\n\t"
+    "mulxq 24(%[a]),%[t0],%[l1]\n\t"
+    "adcxq %[t0],%[l0]\n\t"
+    "adoxq %[z],%[l1]\n\t"
+    "adcxq %[z],%[l1]\n\t"
+    "movq %[l2],%[m2]\n\t"
+    // Row 3 (r3..r6 in l3,l4,l0,l1, r7 in l2)
+    "xorl %k[z],%k[z]\n\t"
+    "movq 24(%[b]),%%rdx\n\t"
+    "mulxq 0(%[a]),%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l3]\n\t"
+    "adoxq %[t1],%[l4]\n\t"
+    "mulxq 8(%[a]),%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l4]\n\t"
+    "adoxq %[t1],%[l0]\n\t"
+    "mulxq 16(%[a]),%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l0]\n\t"
+    "adoxq %[t1],%[l1]\n\t"
+    "mulxq 24(%[a]),%[t0],%[l2]\n\t"
+    "adcxq %[t0],%[l1]\n\t"
+    "adoxq %[z],%[l2]\n\t"
+    "adcxq %[z],%[l2]\n\t"
+    // Reduce from 512 to 320 (r4..r7 in l4,l0,l1,l2)
+    "xorl %k[z],%k[z]\n\t"
+    "movabsq $0x1000003D1,%%rdx\n\t"
+    "mulxq %[l4],%[t0],%[l4]\n\t"
+    "adcxq %[m0],%[t0]\n\t"
+    "movq %[t0],%[m0]\n\t"
+    "mulxq %[l0],%[t1],%[l0]\n\t"
+    "adcxq %[m1],%[t1]\n\t"
+    "adoxq %[l4],%[t1]\n\t"
+    "movq %[t1],%[m1]\n\t"
+    "mulxq %[l1],%[t0],%[l1]\n\t"
+    "adcxq %[m2],%[t0]\n\t"
+    "adoxq %[l0],%[t0]\n\t"
+    "movq %[t0],%[m2]\n\t"
+    "mulxq %[l2],%[t1],%[l2]\n\t"
+    "adcxq %[t1],%[l3]\n\t"
+    "adoxq %[l1],%[l3]\n\t"
+    "adcxq %[z],%[l2]\n\t"
+    "adoxq %[z],%[l2]\n\t"
+    // Reduce from 320 to 256
+    "mulxq %[l2],%[t0],%[t1]\n\t"
+    "movq %[m0],%[l0]\n\t"
+    "movq %[m1],%[l1]\n\t"
+    "movq %[m2],%[l4]\n\t"
+    "addq %[t0],%[l0]\n\t"
+    "adcq %[t1],%[l1]\n\t"
+    "adcq $0,%[l4]\n\t"
+    "adcq $0,%[l3]\n\t"
+    // Last carry (very unlikely)
+    "sbbq %[t0],%[t0]\n\t"
+    "andq %%rdx,%[t0]\n\t"
+    "addq %[t0],%[l0]\n\t"
+    "adcq $0,%[l1]\n\t"
+    "adcq $0,%[l4]\n\t"
+    "adcq $0,%[l3]\n\t"
+    "movq %[l0],0(%[r])\n\t"
+    "movq %[l1],8(%[r])\n\t"
+    "movq %[l4],16(%[r])\n\t"
+    "movq %[l3],24(%[r])\n\t"
+    : [l0] "=&r"(l0),[l1] "=&r"(l1),[l2] "=&r"(l2),[l3] "=&r"(l3),[l4] "=&r"(l4),
+      [t0] "=&r"(t0),[t1] "=&r"(t1),[z] "=&r"(z),
+      [m0] "=m"(m[0]),[m1] "=m"(m[1]),[m2] "=m"(m[2])
+    : [a] "r"(a),[b] "r"(b),[r] "r"(r)
+    : "rdx","cc","memory"
+  );
+
+}
+
+// r = a^2 mod p (r may alias a)
+static void ModSquareK1X(uint64_t *r,const uint64_t *a) {
+
+  uint64_t l0,l1,l2,l3,l4,l5,l6,l7,t0,t1;
+  const uint64_t *ap = a;
+
+  __asm__ volatile (
+    // Cross products
+    "movq 0(%[a]),%%rdx\n\t"
+    "mulxq 8(%[a]),%[l1],%[l2]\n\t"
+    "mulxq 16(%[a]),%[t0],%[l3]\n\t"
+    "addq %[t0],%[l2]\n\t"
+    "mulxq 24(%[a]),%[t0],%[l4]\n\t"
+    "adcq %[t0],%[l3]\n\t"
+    "adcq $0,%[l4]\n\t"
+    "xorl %k[l7],%k[l7]\n\t"
+    "movq 8(%[a]),%%rdx\n\t"
+    "mulxq 16(%[a]),%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l3]\n\t"
+    "adoxq %[t1],%[l4]\n\t"
+    "mulxq 24(%[a]),%[t0],%[l5]\n\t"
+    "adcxq %[t0],%[l4]\n\t"
+    "adoxq %[l7],%[l5]\n\t"
+    "adcxq %[l7],%[l5]\n\t"
+    "movq 16(%[a]),%%rdx\n\t"
+    "mulxq 24(%[a]),%[t0],%[l6]\n\t"
+    "addq %[t0],%[l5]\n\t"
+    "adcq $0,%[l6]\n\t"
+    // Double
+    "addq %[l1],%[l1]\n\t"
+    "adcq %[l2],%[l2]\n\t"
+    "adcq %[l3],%[l3]\n\t"
+    "adcq %[l4],%[l4]\n\t"
+    "adcq %[l5],%[l5]\n\t"
+    "adcq %[l6],%[l6]\n\t"
+    "adcq %[l7],%[l7]\n\t"
+    // Squares
+    "movq 0(%[a]),%%rdx\n\t"
+    "mulxq %%rdx,%[l0],%[t1]\n\t"
+    "addq %[t1],%[l1]\n\t"
+    "movq 8(%[a]),%%rdx\n\t"
+    "mulxq %%rdx,%[t0],%[t1]\n\t"
+    "adcq %[t0],%[l2]\n\t"
+    "adcq %[t1],%[l3]\n\t"
+    "movq 16(%[a]),%%rdx\n\t"
+    "mulxq %%rdx,%[t0],%[t1]\n\t"
+    "adcq %[t0],%[l4]\n\t"
+    "adcq %[t1],%[l5]\n\t"
+    "movq 24(%[a]),%%rdx\n\t"
+    "mulxq %%rdx,%[t0],%[t1]\n\t"
+    "adcq %[t0],%[l6]\n\t"
+    "adcq %[t1],%[l7]\n\t"
+    // Reduce from 512 to 320 (a is used as zero from here)
+    "xorl %k[a],%k[a]\n\t"
+    "movabsq $0x1000003D1,%%rdx\n\t"
+    "mulxq %[l4],%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l0]\n\t"
+    "adoxq %[t1],%[l1]\n\t"
+    "mulxq %[l5],%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l1]\n\t"
+    "adoxq %[t1],%[l2]\n\t"
+    "mulxq %[l6],%[t0],%[t1]\n\t"
+    "adcxq %[t0],%[l2]\n\t"
+    "adoxq %[t1],%[l3]\n\t"
+    "mulxq %[l7],%[t0],%[l4]\n\t"
+    "adcxq %[t0],%[l3]\n\t"
+    "adoxq %[a],%[l4]\n\t"
+    "adcxq %[a],%[l4]\n\t"
+    // Reduce from 320 to 256
+    "mulxq %[l4],%[t0],%[t1]\n\t"
+    "addq %[t0],%[l0]\n\t"
+    "adcq %[t1],%[l1]\n\t"
+    "adcq $0,%[l2]\n\t"
+    "adcq $0,%[l3]\n\t"
+    // Last carry (very unlikely)
+    "sbbq %[t0],%[t0]\n\t"
+    "andq %%rdx,%[t0]\n\t"
+    "addq %[t0],%[l0]\n\t"
+    "adcq $0,%[l1]\n\t"
+    "adcq $0,%[l2]\n\t"
+    "adcq $0,%[l3]\n\t"
+    "movq %[l0],0(%[r])\n\t"
+    "movq %[l1],8(%[r])\n\t"
+    "movq %[l2],16(%[r])\n\t"
+    "movq %[l3],24(%[r])\n\t"
+    : [l0] "=&r"(l0),[l1] "=&r"(l1),[l2] "=&r"(l2),[l3] "=&r"(l3),[l4] "=&r"(l4),
+      [l5] "=&r"(l5),[l6] "=&r"(l6),[l7] "=&r"(l7),[t0] "=&r"(t0),[t1] "=&r"(t1),
+      [a] "+r"(ap)
+    : [r] "r"(r)
+    : "rdx","cc","memory"
+  );
+
+}
+
+// r = a + b mod n (a,b < n, r may alias a or b)
+static void ModAddK1orderX(uint64_t *r,const uint64_t *a,const uint64_t *b) {
+
+  uint64_t r0,r1,r2,r3,t0,t1,t2,t3,cy;
+
+  __asm__ volatile (
+    "movq 0(%[a]),%[r0]\n\t"
+    "movq 8(%[a]),%[r1]\n\t"
+    "movq 16(%[a]),%[r2]\n\t"
+    "movq 24(%[a]),%[r3]\n\t"
+    "addq 0(%[b]),%[r0]\n\t"
+    "adcq 8(%[b]),%[r1]\n\t"
+    "adcq 16(%[b]),%[r2]\n\t"
+    "adcq 24(%[b]),%[r3]\n\t"
+    "movl $0,%k[cy]\n\t"
+    "adcq $0,%[cy]\n\t"
+    // t = a + b - n, keep a + b on borrow
+    "movq %[r0],%[t0]\n\t"
+    "movq %[r1],%[t1]\n\t"
+    "movq %[r2],%[t2]\n\t"
+    "movq %[r3],%[t3]\n\t"
+    "subq %[n0],%[t0]\n\t"
+    "sbbq %[n1],%[t1]\n\t"
+    "sbbq %[n2],%[t2]\n\t"
+    "sbbq %[n3],%[t3]\n\t"
+    "sbbq $0,%[cy]\n\t"
+    "cmovcq %[r0],%[t0]\n\t"
+    "cmovcq %[r1],%[t1]\n\t"
+    "cmovcq %[r2],%[t2]\n\t"
+    "cmovcq %[r3],%[t3]\n\t"
+    "movq %[t0],0(%[r])\n\t"
+    "movq %[t1],8(%[r])\n\t"
+    "movq %[t2],16(%[r])\n\t"
+    "movq %[t3],24(%[r])\n\t"
+    : [r0] "=&r"(r0),[r1] "=&r"(r1),[r2] "=&r"(r2),[r3] "=&r"(r3),
+      [t0] "=&r"(t0),[t1] "=&r"(t1),[t2] "=&r"(t2),[t3] "=&r"(t3),[cy] "=&r"(cy)
+    : [a] "r"(a),[b] "r"(b),[r] "r"(r),
+      [n0] "m"(_K1N[0]),[n1] "m"(_K1N[1]),[n2] "m"(_K1N[2]),[n3] "m"(_K1N[3])
+    : "cc","memory"
+  );
+
+}
+
+// r = r - a mod n (a,r < n)
+static void ModSubK1orderX(uint64_t *r,const uint64_t *a) {
+
+  uint64_t r0,r1,r2,r3,t0,t1,t2,t3,m;
+
+  __asm__ volatile (
+    "movq 0(%[r]),%[r0]\n\t"
+    "movq 8(%[r]),%[r1]\n\t"
+    "movq 16(%[r]),%[r2]\n\t"
+    "movq 24(%[r]),%[r3]\n\t"
+    "subq 0(%[a]),%[r0]\n\t"
+    "sbbq 8(%[a]),%[r1]\n\t"
+    "sbbq 16(%[a]),%[r2]\n\t"
+    "sbbq 24(%[a]),%[r3]\n\t"
+    "sbbq %[m],%[m]\n\t"
+    // Add n on borrow
+    "movq %[n0],%[t0]\n\t"
+    "movq %[n1],%[t1]\n\t"
+    "movq %[n2],%[t2]\n\t"
+    "movq %[n3],%[t3]\n\t"
+    "andq %[m],%[t0]\n\t"
+    "andq %[m],%[t1]\n\t"
+    "andq %[m],%[t2]\n\t"
+    "andq %[m],%[t3]\n\t"
+    "addq %[t0],%[r0]\n\t"
+    "adcq %[t1],%[r1]\n\t"
+    "adcq %[t2],%[r2]\n\t"
+    "adcq %[t3],%[r3]\n\t"
+    "movq %[r0],0(%[r])\n\t"
+    "movq %[r1],8(%[r])\n\t"
+    "movq %[r2],16(%[r])\n\t"
+    "movq %[r3],24(%[r])\n\t"
+    : [r0] "=&r"(r0),[r1] "=&r"(r1),[r2] "=&r"(r2),[r3] "=&r"(r3),
+      [t0] "=&r"(t0),[t1] "=&r"(t1),[t2] "=&r"(t2),[t3] "=&r"(t3),[m] "=&r"(m)
+    : [a] "r"(a),[r] "r"(r),
+      [n0] "m"(_K1N[0]),[n1] "m"(_K1N[1]),[n2] "m"(_K1N[2]),[n3] "m"(_K1N[3])
+    : "cc","memory"
+  );
+
+}
+
+#endif
+
+static bool _k1Mulx = false;   // BMI2/ADX kernels selected
+
+bool Int::SetK1Kernel(bool mulx) {
+#ifdef K1_MULX
+  if(mulx && !K1MulxSupported())
+    return false;
+  _k1Mulx = mulx;
+  return true;
+#else
+  _k1Mulx = false;
+  return !mulx;
+#endif
+}
+
+bool Int::IsK1Mulx() {
+  return _k1Mulx;
+}
+
+// Fe (4 limbs) --------------------------------------------------------------------------------------
+
+// dst = x*y, x has 4 limbs
+static inline void imm_umul4(const uint64_t *x,uint64_t y,uint64_t *dst) {
+
+  unsigned char c = 0;
+  uint64_t h,carry;
+  dst[0] = _umul128(x[0],y,&h); carry = h;
+  c = _addcarry_u64(c,_umul128(x[1],y,&h),carry,dst + 1); carry = h;
+  c = _addcarry_u64(c,_umul128(x[2],y,&h),carry,dst + 2); carry = h;
+  c = _addcarry_u64(c,_umul128(x[3],y,&h),carry,dst + 3); carry = h;
+  _addcarry_u64(c,0ULL,carry,dst + 4);
+
+}
+
+// Portable r = a*b mod p (r may alias a or b)
+static void ModMulK1P(uint64_t *r,const uint64_t *a,const uint64_t *b) {
+
+  unsigned char c;
+  uint64_t r512[8];
+  uint64_t t[5];
+  uint64_t ah,al;
+
+  // 256*256 multiplier
+  imm_umul4(a,b[0],r512);
+  r512[5] = 0;
+  r512[6] = 0;
+  r512[7] = 0;
+  for(int i = 1; i < 4; i++) {
+    imm_umul4(a,b[i],t);
+    c = _addcarry_u64(0,r512[i + 0],t[0],r512 + i + 0);
+    c = _addcarry_u64(c,r512[i + 1],t[1],r512 + i + 1);
+    c = _addcarry_u64(c,r512[i + 2],t[2],r512 + i + 2);
+    c = _addcarry_u64(c,r512[i + 3],t[3],r512 + i + 3);
+    c = _addcarry_u64(c,r512[i + 4],t[4],r512 + i + 4);
+  }
+
+  // Reduce from 512 to 320
+  imm_umul4(r512 + 4,0x1000003D1ULL,t);
+  c = _addcarry_u64(0,r512[0],t[0],r512 + 0);
+  c = _addcarry_u64(c,r512[1],t[1],r512 + 1);
+  c = _addcarry_u64(c,r512[2],t[2],r512 + 2);
+  c = _addcarry_u64(c,r512[3],t[3],r512 + 3);
+
+  // Reduce from 320 to 256
+  al = _umul128(t[4] + c,0x1000003D1ULL,&ah);
+  c = _addcarry_u64(0,r512[0],al,r + 0);
+  c = _addcarry_u64(c,r512[1],ah,r + 1);
+  c = _addcarry_u64(c,r512[2],0ULL,r + 2);
+  c = _addcarry_u64(c,r512[3],0ULL,r + 3);
+
+  // Last carry (very unlikely)
+  al = 0ULL - (uint64_t)c;
+  c = _addcarry_u64(0,r[0],al & 0x1000003D1ULL,r + 0);
+  c = _addcarry_u64(c,r[1],0ULL,r + 1);
+  c = _addcarry_u64(c,r[2],0ULL,r + 2);
+  c = _addcarry_u64(c,r[3],0ULL,r + 3);
+
+}
+
+void Fe::ModMulK1(const Fe *a,const Fe *b) {
+#ifdef K1_MULX
+  if(_k1Mulx) {
+    ModMulK1X(v,a->v,b->v);
+    return;
+  }
+#endif
+  ModMulK1P(v,a->v,b->v);
+}
+
+void Fe::ModMulK1(const Fe *a) {
+#ifdef K1_MULX
+  if(_k1Mulx) {
+    ModMulK1X(v,a->v,v);
+    return;
+  }
+#endif
+  ModMulK1P(v,a->v,v);
+}
+
+void Fe::ModSquareK1(const Fe *a) {
+#ifdef K1_MULX
+  if(_k1Mulx) {
+    ModSquareK1X(v,a->v);
+    return;
+  }
+#endif
+  ModMulK1P(v,a->v,a->v);
+}
+
+void Fe::ModInv() {
+  Int t;
+  Get(&t);
+  t.ModInv();
+  Set(&t);
+}
+
 void Int::ModMulK1(Int *a, Int *b) {
 
+#ifdef K1_MULX
+  if(_k1Mulx) {
+    ModMulK1X(bits64,a->bits64,b->bits64);
+    bits64[4] = 0;
+    return;
+  }
+#endif
+
 #if !defined(WIN64)
 #if defined(__clang__)
   unsigned char c;
@@ -952,6 +1392,14 @@ void Int::ModMulK1(Int *a, Int *b) {
 
 void Int::ModMulK1(Int *a) {
 
+#ifdef K1_MULX
+  if(_k1Mulx) {
+    ModMulK1X(bits64,a->bits64,bits64);
+    bits64[4] = 0;
+    return;
+  }
+#endif
+
 #if !defined(WIN64)
 #if defined(__clang__)
   unsigned char c;
@@ -1032,6 +1480,14 @@ void Int::ModMulK1(Int *a) {
 
 void Int::ModSquareK1(Int *a) {
 
+#ifdef K1_MULX
+  if(_k1Mulx) {
+    ModSquareK1X(bits64,a->bits64);
+    bits64[4] = 0;
+    return;
+  }
+#endif
+
 #if !defined(WIN64)
 #if defined(__clang__)
   unsigned char c;
@@ -1245,9 +1701,17 @@ static Int *_O;                                // SecpK1 order
 void Int::InitK1(Int *order) {
   _O = order;
   _R2o.SetBase16("9D671CD581C69BC5E697F5E45BCD07C6741496C20E7CF878896CF21467D7D140");
+  SetK1Kernel(true);
 }
 
 void Int::ModAddK1order(Int *a, Int *b) {
+#ifdef K1_MULX
+  if(_k1Mulx) {
+    ModAddK1orderX(bits64,a->bits64,b->bits64);
+    bits64[4] = 0;
+    return;
+  }
+#endif
   Add(a,b);
   Sub(_O);
   if (IsNegative())
@@ -1255,6 +1719,13 @@ void Int::ModAddK1order(Int *a, Int *b) {
 }
 
 void Int::ModAddK1order(Int *a) {
+#ifdef K1_MULX
+  if(_k1Mulx) {
+    ModAddK1orderX(bits64,bits64,a->bits64);
+    bits64[4] = 0;
+    return;
+  }
+#endif
   Add(a);
   Sub(_O);
   if(IsNegative())
@@ -1262,6 +1733,13 @@ void Int::ModAddK1order(Int *a) {
 }
 
 void Int::ModSubK1order(Int *a) {
+#ifdef K1_MULX
+  if(_k1Mulx) {
+    ModSubK1orderX(bits64,a->bits64);
+    bits64[4] = 0;
+    return;
+  }
+#endif
   Sub(a);
   if(IsNegative())
     Add(_O);
@@ -16,6 +16,9 @@
 */
 
 #include "Random.h"
+#include <atomic>
+#include <mutex>
+#include <random>
 
 #define  RK_STATE_LEN 624
 
@@ -115,3 +118,62 @@ unsigned long rndl() {
 double rnd() {
   return rk_double(&localState);
 }
+
+// ----------------------------------------------------------------------------
+// Per thread streams (xoshiro256**). A thread seeds its state on first use
+// from a process wide random base and a stream counter (splitmix64), so
+// streams are independent of each other and of rseed().
+
+typedef struct rq_state_
+{
+  uint64_t s[4];
+  bool init;
+} rq_state;
+
+static thread_local rq_state qState = { {0,0,0,0},false };
+static std::atomic<uint64_t> qStream(0);
+static std::once_flag qOnce;
+static uint64_t qBase;
+
+static inline uint64_t splitmix64(uint64_t *x)
+{
+  uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x,int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+static void rq_seed(rq_state *state)
+{
+  std::call_once(qOnce,[]() {
+    std::random_device rd;
+    qBase = ((uint64_t)rd() << 32) | (uint64_t)rd();
+  });
+  uint64_t x = qBase ^ (qStream++ * 0xD1B54A32D192ED03ULL);
+  for(int i = 0; i < 4; i++)
+    state->s[i] = splitmix64(&x);
+  state->init = true;
+}
+
+uint64_t rndq() {
+
+  rq_state *q = &qState;
+  if(!q->init)
+    rq_seed(q);
+
+  uint64_t r = rotl(q->s[1] * 5,7) * 9;
+  uint64_t t = q->s[1] << 17;
+  q->s[2] ^= q->s[0];
+  q->s[3] ^= q->s[1];
+  q->s[1] ^= q->s[2];
+  q->s[0] ^= q->s[3];
+  q->s[2] ^= t;
+  q->s[3] = rotl(q->s[3],45);
+  return r;
+
+}
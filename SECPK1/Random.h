@@ -18,8 +18,13 @@
 #ifndef RANDOM_H
 #define RANDOM_H
 
+#include <stdint.h>
+
 double rnd();
 unsigned long rndl();
 void rseed(unsigned long seed);
 
+// Per thread stream, no lock needed
+uint64_t rndq();
+
 #endif
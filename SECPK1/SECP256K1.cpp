@@ -17,10 +17,76 @@
 
 #include "SECP256k1.h"
 #include "IntGroup.h"
+#include "Fe.h"
+#include "../HugePage.h"
 #include <string.h>
 #include <cstdio>
+#include <stdlib.h>
+#include <thread>
+#ifndef WIN64
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Wide table cache file header
+#define GTABLE_MAGIC   0x5457474BU // "KGWT"
+#define GTABLE_VERSION 1
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t windowBit;
+  uint32_t nbWindow;
+  uint64_t nbEntry;
+  uint64_t checksum;
+  uint64_t pad[4];
+} GTABLE_HEADER;
+
+static inline int GetNbWindow(int windowBit) {
+  return (256 + windowBit - 1) / windowBit;
+}
+
+static uint64_t GetChecksum(uint64_t *t,size_t nbWord) {
+  uint64_t h = 0xCBF29CE484222325ULL;
+  for(size_t i = 0; i < nbWord; i++) {
+    h = (h ^ t[i]) * 0x100000001B3ULL;
+    h ^= h >> 29;
+  }
+  return h;
+}
+
+// (X,Y,Z) <- (X,Y,Z) + (x2,y2), projective + affine, as Add2()
+static inline void AddMixed(Fe *X,Fe *Y,Fe *Z,const Fe *x2,const Fe *y2) {
+
+  Fe u,v,us2,vs2,vs3,vs2v2,a,t;
+  u.ModMulK1(y2,Z);
+  u.ModSubK1(Y);
+  v.ModMulK1(x2,Z);
+  v.ModSubK1(X);
+  us2.ModSquareK1(&u);
+  vs2.ModSquareK1(&v);
+  vs3.ModMulK1(&vs2,&v);
+  us2.ModMulK1(Z);
+  vs2v2.ModMulK1(&vs2,X);
+  a.ModSubK1(&us2,&vs3);
+  a.ModSubK1(&vs2v2);
+  a.ModSubK1(&vs2v2);
+  X->ModMulK1(&v,&a);
+  t.ModSubK1(&vs2v2,&a);
+  t.ModMulK1(&u);
+  Y->ModMulK1(&vs3);
+  Y->ModSubK1(&t,Y);
+  Z->ModMulK1(&vs3);
+
+}
 
 Secp256K1::Secp256K1() {
+  wBit = 0;
+  wTable = NULL;
+  wSize = 0;
+  wMap = NULL;
 }
 
 void Secp256K1::Init() {
@@ -55,10 +121,264 @@ void Secp256K1::Init() {
 }
 
 Secp256K1::~Secp256K1() {
+  FreeTable();
+}
+
+void Secp256K1::FreeTable() {
+
+#ifndef WIN64
+  if(wMap)
+    munmap(wMap,wSize);
+  else
+#endif
+    HugePage::Free(wTable,wSize);
+  wBit = 0;
+  wTable = NULL;
+  wSize = 0;
+  wMap = NULL;
+
+}
+
+int Secp256K1::GetTableBit() {
+  return wBit;
+}
+
+void Secp256K1::BuildTable(uint64_t *table,int windowBit) {
+
+  // Window i: base 2^(windowBit.i).G, multiples doubled in number by
+  // each batched addition, (k+1+n).B = (k+1).B + n.B. Windows are
+  // independent and spread over the cores.
+  int nbWindow = GetNbWindow(windowBit);
+  size_t nbPerWindow = ((size_t)1 << windowBit) - 1;
+  int nbThread = (int)std::thread::hardware_concurrency();
+  if(nbThread < 1) nbThread = 1;
+  if(nbThread > nbWindow) nbThread = nbWindow;
+
+  auto build = [&](int t) {
+    std::vector<Point> p1;
+    std::vector<Point> p2;
+    std::vector<Point> P;
+    std::vector<Point> M((size_t)1 << windowBit);
+    for(int i = t; i < nbWindow; i += nbThread) {
+      Int k;
+      k.SetInt32(1);
+      k.ShiftL(windowBit * i);
+      M[0] = ComputePublicKeyByte(&k);
+      for(size_t n = 1; n < nbPerWindow; n *= 2) {
+        if(n > 1) {
+          p1.assign(M.begin(),M.begin() + (n - 1));
+          p2.assign(n - 1,M[n - 1]);
+          P = AddDirect(p1,p2);
+          for(size_t j = 0; j < n - 1; j++)
+            M[n + j] = P[j];
+        }
+        M[2 * n - 1] = DoubleDirect(M[n - 1]);
+      }
+      uint64_t *e = table + (size_t)i * nbPerWindow * 8;
+      for(size_t j = 0; j < nbPerWindow; j++, e += 8) {
+        memcpy(e,M[j].x.bits64,32);
+        memcpy(e + 4,M[j].y.bits64,32);
+      }
+    }
+  };
+
+  std::vector<std::thread> th;
+  for(int t = 1; t < nbThread; t++)
+    th.push_back(std::thread(build,t));
+  build(0);
+  for(int t = 0; t < (int)th.size(); t++)
+    th[t].join();
+
+}
+
+bool Secp256K1::MapTable(std::string &cacheFile,int windowBit) {
+
+  // Map the cache file read only (shared by the processes of the host),
+  // check header, checksum and the base of the last window
+  int nbWindow = GetNbWindow(windowBit);
+  uint64_t nbEntry = (uint64_t)nbWindow * (((uint64_t)1 << windowBit) - 1);
+  size_t size = sizeof(GTABLE_HEADER) + nbEntry * 64;
+  GTABLE_HEADER *head;
+  uint64_t *t;
+
+#ifndef WIN64
+  int fd = open(cacheFile.c_str(),O_RDONLY);
+  if(fd < 0)
+    return false;
+  struct stat st;
+  if(fstat(fd,&st) != 0 || (size_t)st.st_size != size) {
+    close(fd);
+    return false;
+  }
+  void *m = mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0);
+  close(fd);
+  if(m == MAP_FAILED)
+    return false;
+  head = (GTABLE_HEADER *)m;
+  t = (uint64_t *)((uint8_t *)m + sizeof(GTABLE_HEADER));
+#else
+  // Table read apart from the header, 64 bytes aligned (read as Fe)
+  FILE *f = fopen(cacheFile.c_str(),"rb");
+  if(f == NULL)
+    return false;
+  GTABLE_HEADER hd;
+  head = &hd;
+  t = (uint64_t *)HugePage::Alloc(nbEntry * 64);
+  bool rOk = fread(&hd,sizeof(hd),1,f) == 1 && fread(t,64,nbEntry,f) == nbEntry && fgetc(f) == EOF;
+  fclose(f);
+  if(!rOk) {
+    HugePage::Free(t,nbEntry * 64);
+    return false;
+  }
+#endif
+  bool ok = head->magic == GTABLE_MAGIC && head->version == GTABLE_VERSION &&
+            head->windowBit == (uint32_t)windowBit && head->nbWindow == (uint32_t)nbWindow &&
+            head->nbEntry == nbEntry && head->checksum == GetChecksum(t,nbEntry * 8);
+  if(ok) {
+    Int k;
+    k.SetInt32(1);
+    k.ShiftL(windowBit * (nbWindow - 1));
+    Point B = ComputePublicKeyByte(&k);
+    uint64_t *e = t + (nbEntry - (((uint64_t)1 << windowBit) - 1)) * 8;
+    ok = memcmp(e,B.x.bits64,32) == 0 && memcmp(e + 4,B.y.bits64,32) == 0;
+  }
+
+  if(!ok) {
+#ifndef WIN64
+    munmap(head,size);
+#else
+    HugePage::Free(t,nbEntry * 64);
+#endif
+    return false;
+  }
+
+  wBit = windowBit;
+  wTable = t;
+#ifndef WIN64
+  // Page aligned map, the table starts 64 bytes after
+  wMap = head;
+  wSize = size;
+#else
+  wSize = nbEntry * 64;
+#endif
+  return true;
+
+}
+
+bool Secp256K1::InitTable(int windowBit,std::string cacheFile) {
+
+  // Wide window fixed base table, loaded from the cache file or created
+  // and saved (empty file name: no cache)
+  FreeTable();
+  if(windowBit < GTABLE_MIN_BIT || windowBit > GTABLE_MAX_BIT) {
+    ::printf("SecpK1: invalid table window %d bits [%d..%d]\n",windowBit,GTABLE_MIN_BIT,GTABLE_MAX_BIT);
+    return false;
+  }
+
+  int nbWindow = GetNbWindow(windowBit);
+  uint64_t nbEntry = (uint64_t)nbWindow * (((uint64_t)1 << windowBit) - 1);
+  double sizeMB = (double)nbEntry * 64.0 / (1024.0 * 1024.0);
+
+  if(cacheFile.length() > 0 && MapTable(cacheFile,windowBit)) {
+    ::printf("SecpK1: %d-bit window table, %.1f MB, mapped from %s\n",windowBit,sizeMB,cacheFile.c_str());
+    return true;
+  }
+
+  // Entries are read as Fe (alignas(32)), 64 bytes aligned
+  uint64_t *t = (uint64_t *)HugePage::Alloc(nbEntry * 64);
+  BuildTable(t,windowBit);
+  wBit = windowBit;
+  wTable = t;
+  wSize = nbEntry * 64;
+  ::printf("SecpK1: %d-bit window table, %.1f MB, created\n",windowBit,sizeMB);
+
+  if(cacheFile.length() == 0)
+    return true;
+
+  // Write a temporary file then rename, other processes only see
+  // a complete table
+  GTABLE_HEADER head;
+  memset(&head,0,sizeof(head));
+  head.magic = GTABLE_MAGIC;
+  head.version = GTABLE_VERSION;
+  head.windowBit = (uint32_t)windowBit;
+  head.nbWindow = (uint32_t)nbWindow;
+  head.nbEntry = nbEntry;
+  head.checksum = GetChecksum(t,nbEntry * 8);
+
+  char suffix[32];
+#ifndef WIN64
+  snprintf(suffix,sizeof(suffix),".%d.tmp",(int)getpid());
+#else
+  snprintf(suffix,sizeof(suffix),".tmp");
+#endif
+  std::string tmpName = cacheFile + suffix;
+  FILE *f = fopen(tmpName.c_str(),"wb");
+  bool ok = f != NULL;
+  if(ok) {
+    ok = fwrite(&head,sizeof(head),1,f) == 1 && fwrite(t,64,nbEntry,f) == nbEntry;
+    ok = (fclose(f) == 0) && ok;
+  }
+#ifdef WIN64
+  if(ok) remove(cacheFile.c_str());
+#endif
+  if(ok)
+    ok = rename(tmpName.c_str(),cacheFile.c_str()) == 0;
+  if(!ok) {
+    remove(tmpName.c_str());
+    ::printf("SecpK1: cannot write table cache %s\n",cacheFile.c_str());
+  }
+  return true;
+
 }
 
 Point Secp256K1::ComputePublicKey(Int *privKey,bool reduce) {
 
+  if(wTable == NULL)
+    return ComputePublicKeyByte(privKey,reduce);
+
+  // One mixed addition per non zero window
+  int nbWindow = GetNbWindow(wBit);
+  size_t nbPerWindow = ((size_t)1 << wBit) - 1;
+  uint64_t mask = ((uint64_t)1 << wBit) - 1;
+  bool first = true;
+  Fe X,Y,Z;
+  Point Q;
+  Q.Clear();
+
+  for(int i = 0; i < nbWindow; i++) {
+    int pos = i * wBit;
+    int l = pos / 64;
+    int s = pos % 64;
+    uint64_t b = privKey->bits64[l] >> s;
+    if(s + wBit > 64 && l + 1 < NB64BLOCK)
+      b |= privKey->bits64[l + 1] << (64 - s);
+    b &= mask;
+    if(b) {
+      const Fe *e = (const Fe *)(wTable + ((size_t)i * nbPerWindow + (b - 1)) * 8);
+      if(first) {
+        X.Set(e);
+        Y.Set(e + 1);
+        Z.SetInt32(1);
+        first = false;
+      } else {
+        AddMixed(&X,&Y,&Z,e,e + 1);
+      }
+    }
+  }
+
+  if(!first) {
+    X.Get(&Q.x);
+    Y.Get(&Q.y);
+    Z.Get(&Q.z);
+  }
+  if(reduce) Q.Reduce();
+  return Q;
+
+}
+
+Point Secp256K1::ComputePublicKeyByte(Int *privKey,bool reduce) {
+
   int i = 0;
   uint8_t b;
   Point Q;
@@ -91,7 +411,7 @@ std::vector<Point> Secp256K1::ComputePublicKeys(std::vector<Int> &privKeys) {
 
   std::vector<Point> pts;
   IntGroup grp((int)privKeys.size());
-  Int *inv = new Int[privKeys.size()];
+  Fe *inv = new Fe[privKeys.size()];
   pts.reserve(privKeys.size());
 
   for(size_t i=0;i<privKeys.size();i++) {
@@ -103,9 +423,15 @@ std::vector<Point> Secp256K1::ComputePublicKeys(std::vector<Int> &privKeys) {
   grp.Set(inv);
   grp.ModInv();
 
+  Fe x;
+  Fe y;
   for(size_t i = 0; i<privKeys.size(); i++) {
-    pts[i].x.ModMulK1(inv + i);
-    pts[i].y.ModMulK1(inv + i);
+    x.Set(&pts[i].x);
+    y.Set(&pts[i].y);
+    x.ModMulK1(inv + i);
+    y.ModMulK1(inv + i);
+    x.Get(&pts[i].x);
+    y.Get(&pts[i].y);
     pts[i].z.SetInt32(1);
   }
 
@@ -238,27 +564,34 @@ std::string Secp256K1::GetPublicKeyHex(bool compressed, Point &pubKey) {
 
 Point Secp256K1::AddDirect(Point &p1,Point &p2) {
 
-  Int _s;
-  Int _p;
-  Int dy;
-  Int dx;
+  Fe _s;
+  Fe _p;
+  Fe dy;
+  Fe dx;
+  Fe p1x,p1y,p2x,p2y;
+  Fe rx,ry;
   Point r;
   r.z.SetInt32(1);
 
-  dy.ModSub(&p2.y,&p1.y);
-  dx.ModSub(&p2.x,&p1.x);
+  p1x.Set(&p1.x); p1y.Set(&p1.y);
+  p2x.Set(&p2.x); p2y.Set(&p2.y);
+
+  dy.ModSubK1(&p2y,&p1y);
+  dx.ModSubK1(&p2x,&p1x);
   dx.ModInv();
   _s.ModMulK1(&dy,&dx);     // s = (p2.y-p1.y)*inverse(p2.x-p1.x);
 
   _p.ModSquareK1(&_s);       // _p = pow2(s)
 
-  r.x.ModSub(&_p,&p1.x);
-  r.x.ModSub(&p2.x);       // rx = pow2(s) - p1.x - p2.x;
+  rx.ModSubK1(&_p,&p1x);
+  rx.ModSubK1(&p2x);       // rx = pow2(s) - p1.x - p2.x;
 
-  r.y.ModSub(&p2.x,&r.x);
-  r.y.ModMulK1(&_s);
-  r.y.ModSub(&p2.y);       // ry = - p2.y - s*(ret.x-p2.x);  
+  ry.ModSubK1(&p2x,&rx);
+  ry.ModMulK1(&_s);
+  ry.ModSubK1(&p2y);       // ry = - p2.y - s*(ret.x-p2.x);  
 
+  rx.Get(&r.x);
+  ry.Get(&r.y);
   return r;
 
 }
@@ -277,17 +610,22 @@ std::vector<Point> Secp256K1::AddDirect(std::vector<Point> &p1,std::vector<Point
 
   std::vector<Point> pts;
   IntGroup grp(size);
-  Int *dx = new Int[size];
+  Fe *dx = new Fe[size];
   pts.reserve(size);
 
-  Int _s;
-  Int _p;
-  Int dy;
+  Fe _s;
+  Fe _p;
+  Fe dy;
+  Fe p1x,p1y,p2x,p2y;
+  Fe rx,ry;
   Point r;
+  r.z.SetInt32(1);
 
   // Compute DX
   for(int i=0;i<size;i++) {
-    dx[i].ModSub(&p2[i].x,&p1[i].x);
+    p1x.Set(&p1[i].x);
+    p2x.Set(&p2[i].x);
+    dx[i].ModSubK1(&p2x,&p1x);
   }
   grp.Set(dx);
   grp.ModInv();
@@ -300,18 +638,23 @@ std::vector<Point> Secp256K1::AddDirect(std::vector<Point> &p1,std::vector<Point
 
     } else {
 
-      dy.ModSub(&p2[i].y,&p1[i].y);
+      p1x.Set(&p1[i].x); p1y.Set(&p1[i].y);
+      p2x.Set(&p2[i].x); p2y.Set(&p2[i].y);
+
+      dy.ModSubK1(&p2y,&p1y);
       _s.ModMulK1(&dy,&dx[i]);     // s = (p2.y-p1.y)*inverse(p2.x-p1.x);
 
       _p.ModSquareK1(&_s);       // _p = pow2(s)
 
-      r.x.ModSub(&_p,&p1[i].x);
-      r.x.ModSub(&p2[i].x);       // rx = pow2(s) - p1.x - p2.x;
+      rx.ModSubK1(&_p,&p1x);
+      rx.ModSubK1(&p2x);       // rx = pow2(s) - p1.x - p2.x;
 
-      r.y.ModSub(&p2[i].x,&r.x);
-      r.y.ModMulK1(&_s);
-      r.y.ModSub(&p2[i].y);       // ry = - p2.y - s*(ret.x-p2.x);  
+      ry.ModSubK1(&p2x,&rx);
+      ry.ModMulK1(&_s);
+      ry.ModSubK1(&p2y);       // ry = - p2.y - s*(ret.x-p2.x);  
 
+      rx.Get(&r.x);
+      ry.Get(&r.y);
       pts.push_back(r);
 
     }
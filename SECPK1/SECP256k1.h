@@ -22,6 +22,10 @@
 #include <string>
 #include <vector>
 
+// Wide window fixed base table (InitTable), window size bounds
+#define GTABLE_MIN_BIT 9
+#define GTABLE_MAX_BIT 18
+
 class Secp256K1 {
 
 public:
@@ -29,7 +33,10 @@ public:
   Secp256K1();
   ~Secp256K1();
   void  Init();
+  bool  InitTable(int windowBit,std::string cacheFile);
+  int   GetTableBit();
   Point ComputePublicKey(Int *privKey,bool reduce=true);
+  Point ComputePublicKeyByte(Int *privKey,bool reduce=true);
   std::vector<Point> ComputePublicKeys(std::vector<Int> &privKeys);
   Point NextKey(Point &key);
   bool  EC(Point &p);
@@ -53,8 +60,19 @@ private:
   uint8_t GetByte(std::string &str,int idx);
 
   Int GetY(Int x, bool isEven);
+  void BuildTable(uint64_t *table,int windowBit);
+  bool MapTable(std::string &cacheFile,int windowBit);
+  void FreeTable();
+
   Point GTable[256*32];       // Generator table
 
+  // Wide window table, affine x,y (4x64 bits each) of j.2^(wBit.i).G
+  // for j in [1,2^wBit), window i after window i-1
+  int       wBit;
+  uint64_t *wTable;
+  size_t    wSize;            // Mapped or allocated size
+  void     *wMap;
+
 };
 
 #endif // SECP256K1H
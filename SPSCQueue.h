@@ -0,0 +1,79 @@
+/*
+ * This file is part of the BSGS distribution (https://github.com/JeanLucPons/Kangaroo).
+ * Copyright (c) 2020 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPSCQUEUEH
+#define SPSCQUEUEH
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer / single consumer ring buffer.
+// Capacity is rounded up to a power of 2.
+template<typename T>
+class SPSCQueue {
+
+public:
+
+  SPSCQueue(uint32_t capacity) {
+    size = 1;
+    while(size < capacity) size <<= 1;
+    mask = size - 1;
+    buffer = new T[size];
+    head.store(0);
+    tail.store(0);
+  }
+
+  ~SPSCQueue() {
+    delete[] buffer;
+  }
+
+  // Producer side, false if full
+  bool Push(const T &item) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if(t - head.load(std::memory_order_acquire) >= size)
+      return false;
+    buffer[t & mask] = item;
+    tail.store(t + 1,std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, false if empty
+  bool Pop(T *item) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if(h == tail.load(std::memory_order_acquire))
+      return false;
+    *item = buffer[h & mask];
+    head.store(h + 1,std::memory_order_release);
+    return true;
+  }
+
+  uint32_t GetSize() {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+  }
+
+private:
+
+  T *buffer;
+  uint32_t size;
+  uint32_t mask;
+  // Producer and consumer indexes on their own cache line
+  alignas(64) std::atomic<uint32_t> head;
+  alignas(64) std::atomic<uint32_t> tail;
+
+};
+
+#endif // SPSCQUEUEH
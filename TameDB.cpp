@@ -0,0 +1,210 @@
+/*
+ * This file is part of the BSGS distribution (https://github.com/JeanLucPons/Kangaroo).
+ * Copyright (c) 2020 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TameDB.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#ifndef WIN64
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+static inline bool Less(const TDB_ENTRY &a,const TDB_ENTRY &b) {
+  return (a.x[1] < b.x[1]) || (a.x[1] == b.x[1] && a.x[0] < b.x[0]);
+}
+
+// ----------------------------------------------------------------------------
+
+TameDB::TameDB() {
+  memset(&head,0,sizeof(head));
+  entry = NULL;
+  map = NULL;
+  mapSize = 0;
+}
+
+TameDB::~TameDB() {
+  Close();
+}
+
+// ----------------------------------------------------------------------------
+
+uint64_t TameDB::GetJumpHash(Int *jumpDistance,int nbJump) {
+
+  uint64_t h = 0xCBF29CE484222325ULL;
+  for(int i = 0; i < nbJump; i++) {
+    for(int j = 0; j < 4; j++) {
+      h = (h ^ jumpDistance[i].bits64[j]) * 0x100000001B3ULL;
+      h ^= h >> 29;
+    }
+  }
+  return h;
+
+}
+
+// ----------------------------------------------------------------------------
+
+bool TameDB::Save(string fileName,HashTable *table,int rangePower,bool symmetry,uint32_t dpSize,uint64_t jumpHash) {
+
+  vector<TDB_ENTRY> e;
+  e.reserve(table->GetNbItem());
+  for(int h = 0; h < HASH_SIZE; h++) {
+    for(uint32_t i = 0; i < table->E[h].nbItem; i++) {
+      ENTRY *it = table->E[h].items[i];
+      if(it->kType != TAME)
+        continue;
+      TDB_ENTRY t;
+      t.x[0] = it->x.i64[2];
+      t.x[1] = it->x.i64[3];
+      t.d = it->d;
+      e.push_back(t);
+    }
+  }
+  std::sort(e.begin(),e.end(),Less);
+
+  TDB_HEADER hd;
+  memset(&hd,0,sizeof(hd));
+  hd.magic = TDB_MAGIC;
+  hd.version = TDB_VERSION;
+  hd.rangePower = (uint32_t)rangePower;
+  hd.symmetry = symmetry ? 1 : 0;
+  hd.dpSize = dpSize;
+  hd.nbEntry = e.size();
+  hd.jumpHash = jumpHash;
+
+  // Write a temporary file then rename, as the table cache
+  string tmpName = fileName + ".tmp";
+  FILE *f = fopen(tmpName.c_str(),"wb");
+  bool ok = f != NULL;
+  if(ok) {
+    ok = fwrite(&hd,sizeof(hd),1,f) == 1 && fwrite(e.data(),sizeof(TDB_ENTRY),e.size(),f) == e.size();
+    ok = (fclose(f) == 0) && ok;
+  }
+#ifdef WIN64
+  if(ok) remove(fileName.c_str());
+#endif
+  if(ok)
+    ok = rename(tmpName.c_str(),fileName.c_str()) == 0;
+  if(!ok) {
+    remove(tmpName.c_str());
+    ::printf("TameDB: cannot write %s\n",fileName.c_str());
+    return false;
+  }
+
+  ::printf("TameDB: %.0f tame DP, %.1f MB, written to %s\n",(double)e.size(),
+           (double)(sizeof(hd) + e.size() * sizeof(TDB_ENTRY)) / (1024.0 * 1024.0),fileName.c_str());
+  return true;
+
+}
+
+// ----------------------------------------------------------------------------
+
+bool TameDB::Load(string fileName) {
+
+  Close();
+
+#ifndef WIN64
+  int fd = open(fileName.c_str(),O_RDONLY);
+  if(fd < 0) {
+    ::printf("TameDB: cannot open %s\n",fileName.c_str());
+    return false;
+  }
+  struct stat st;
+  if(fstat(fd,&st) != 0 || (size_t)st.st_size < sizeof(TDB_HEADER)) {
+    close(fd);
+    ::printf("TameDB: %s is not a tame DP database\n",fileName.c_str());
+    return false;
+  }
+  size_t size = (size_t)st.st_size;
+  void *m = mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0);
+  close(fd);
+  if(m == MAP_FAILED) {
+    ::printf("TameDB: cannot map %s\n",fileName.c_str());
+    return false;
+  }
+  map = (uint8_t *)m;
+  mapSize = size;
+#else
+  FILE *f = fopen(fileName.c_str(),"rb");
+  if(f == NULL) {
+    ::printf("TameDB: cannot open %s\n",fileName.c_str());
+    return false;
+  }
+  fseek(f,0,SEEK_END);
+  size_t size = (size_t)ftell(f);
+  fseek(f,0,SEEK_SET);
+  map = (uint8_t *)malloc(size);
+  bool rOk = size >= sizeof(TDB_HEADER) && fread(map,1,size,f) == size;
+  fclose(f);
+  mapSize = size;
+  if(!rOk) {
+    Close();
+    ::printf("TameDB: %s is not a tame DP database\n",fileName.c_str());
+    return false;
+  }
+#endif
+
+  memcpy(&head,map,sizeof(head));
+  if(head.magic != TDB_MAGIC || head.version != TDB_VERSION ||
+     mapSize != sizeof(TDB_HEADER) + head.nbEntry * sizeof(TDB_ENTRY)) {
+    Close();
+    ::printf("TameDB: %s is not a tame DP database\n",fileName.c_str());
+    return false;
+  }
+  entry = (TDB_ENTRY *)(map + sizeof(TDB_HEADER));
+  return true;
+
+}
+
+void TameDB::Close() {
+
+  if(map) {
+#ifndef WIN64
+    munmap(map,mapSize);
+#else
+    free(map);
+#endif
+  }
+  map = NULL;
+  mapSize = 0;
+  entry = NULL;
+  memset(&head,0,sizeof(head));
+
+}
+
+// ----------------------------------------------------------------------------
+
+bool TameDB::Find(int256_t *x,Int *d) {
+
+  // Binary search, the DP come at a low rate
+  TDB_ENTRY k;
+  k.x[0] = x->i64[2];
+  k.x[1] = x->i64[3];
+  TDB_ENTRY *e = std::lower_bound(entry,entry + head.nbEntry,k,Less);
+  if(e == entry + head.nbEntry || e->x[0] != k.x[0] || e->x[1] != k.x[1])
+    return false;
+  d->SetInt32(0);
+  HashTable::toInt(&e->d,d);
+  return true;
+
+}
@@ -0,0 +1,74 @@
+/*
+ * This file is part of the BSGS distribution (https://github.com/JeanLucPons/Kangaroo).
+ * Copyright (c) 2020 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TAMEDBH
+#define TAMEDBH
+
+#include <string>
+#include "HashTable.h"
+
+#define TDB_MAGIC   0x4244544BU // "KTDB"
+#define TDB_VERSION 1
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t rangePower;
+  uint32_t symmetry;
+  uint32_t dpSize;
+  uint32_t pad0;
+  uint64_t nbEntry;
+  uint64_t jumpHash;
+  uint64_t pad[3];
+} TDB_HEADER;
+
+typedef struct {
+  uint64_t x[2]; // Position, 128 most significant bits (LSB first)
+  int256_t d;    // Tame distance
+} TDB_ENTRY;
+
+// Precomputed tame DP (-tdb). Tame walks only depend on the range width,
+// the jump table and the DP size (InitSearchKey() translates the key to
+// [0,N]), so they can be walked once and reused for all the keys of that
+// width. Entries are sorted by x, the file is mapped read only and shared.
+class TameDB {
+
+public:
+
+  TameDB();
+  ~TameDB();
+
+  // Write the tame DP of a table, sorted
+  static bool Save(std::string fileName,HashTable *table,int rangePower,bool symmetry,uint32_t dpSize,
+                   uint64_t jumpHash);
+  static uint64_t GetJumpHash(Int *jumpDistance,int nbJump);
+
+  bool Load(std::string fileName);
+  void Close();
+  bool Find(int256_t *x,Int *d);
+
+  TDB_HEADER head;
+
+private:
+
+  TDB_ENTRY *entry;
+  uint8_t *map;
+  size_t mapSize;
+
+};
+
+#endif // TAMEDBH
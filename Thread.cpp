@@ -81,7 +81,7 @@ bool Kangaroo::hasStarted(TH_PARAM *p) {
   bool hasStarted = true;
   int total = nbCPUThread + nbGPUThread;
   for (int i = 0; i < total; i++)
-    hasStarted = hasStarted && p[i].hasStarted;
+    hasStarted = hasStarted && (p[i].hasStarted || !p[i].isRunning);
 
   return hasStarted;
 
@@ -94,7 +94,7 @@ bool Kangaroo::isWaiting(TH_PARAM *p) {
   bool isWaiting = true;
   int total = nbCPUThread + nbGPUThread;
   for (int i = 0; i < total; i++)
-    isWaiting = isWaiting && p[i].isWaiting;
+    isWaiting = isWaiting && (p[i].isWaiting || !p[i].isRunning);
 
   return isWaiting;
 
@@ -106,7 +106,7 @@ uint64_t Kangaroo::getGPUCount() {
 
   uint64_t count = 0;
   for(int i = 0; i<nbGPUThread; i++)
-    count += counters[0x80L + i];
+    count += counters[0x80L + i].count;
   return count;
 
 }
@@ -117,13 +117,124 @@ uint64_t Kangaroo::getCPUCount() {
 
   uint64_t count = 0;
   for(int i=0;i<nbCPUThread;i++)
-    count += counters[i];
+    count += counters[i].count;
   return count;
 
 }
 
 // ----------------------------------------------------------------------------
 
+double Kangaroo::getWalkStats(TH_PARAM *params,uint64_t *hist,uint64_t *stuck) {
+
+  // CPU walk telemetry, returns the total variation distance between the
+  // DP inter-arrival histogram and the geometric distribution
+  uint64_t nbDP = 0;
+  memset(hist,0,DPL_BUCKET * sizeof(uint64_t));
+  *stuck = 0;
+  for(int i = 0; i < nbCPUThread; i++) {
+    for(int b = 0; b < DPL_BUCKET; b++)
+      hist[b] += params[i].dpHist[b];
+    *stuck += params[i].nbStuck;
+  }
+  for(int b = 0; b < DPL_BUCKET; b++)
+    nbDP += hist[b];
+  if(nbDP == 0)
+    return 0.0;
+
+  double tv = 0.0;
+  for(int b = 0; b < DPL_BUCKET; b++)
+    tv += fabs((double)hist[b] / (double)nbDP - CPUEngine::GetExpectedDPL(b,dpSize));
+  return tv / 2.0;
+
+}
+
+void Kangaroo::PrintWalkStats(TH_PARAM *params) {
+
+  uint64_t hist[DPL_BUCKET];
+  uint64_t stuck;
+  double tv = getWalkStats(params,hist,&stuck);
+  uint64_t nbDP = 0;
+  for(int b = 0; b < DPL_BUCKET; b++)
+    nbDP += hist[b];
+  if(nbDP == 0)
+    return;
+
+  const char *label[DPL_BUCKET] = { "<1/8","1/8","1/4","1/2","1","2","4","8","16+" };
+  ::printf("DP length (x2^%d): %.0f DP, %.0f stuck reset, deviation %.1f%%\n",dpSize,(double)nbDP,(double)stuck,tv * 100.0);
+  ::printf("  Len ");
+  for(int b = 0; b < DPL_BUCKET; b++) ::printf(" %6s",label[b]);
+  ::printf("\n  Obs ");
+  for(int b = 0; b < DPL_BUCKET; b++) ::printf(" %5.1f%%",100.0 * (double)hist[b] / (double)nbDP);
+  ::printf("\n  Geo ");
+  for(int b = 0; b < DPL_BUCKET; b++) ::printf(" %5.1f%%",100.0 * CPUEngine::GetExpectedDPL(b,dpSize));
+  ::printf("\n");
+
+}
+
+// ----------------------------------------------------------------------------
+
+static void PrintProfileRow(const char *name,uint64_t *cycles,uint64_t *hw,bool hwOk,uint64_t nbStep,
+                            int firstPhase,int lastPhase) {
+
+  uint64_t total = 0;
+  for(int i = firstPhase; i <= lastPhase; i++)
+    total += cycles[i];
+  if(total == 0 || nbStep == 0)
+    return;
+
+  ::printf("  %-6s %9.1f",name,(double)total / (double)nbStep);
+  for(int i = firstPhase; i <= lastPhase; i++)
+    ::printf(" %5.1f%%",100.0 * (double)cycles[i] / (double)total);
+  if(hwOk && hw[PROF_HW_CYCLE] > 0)
+    ::printf("  %5.2f %9.3f\n",(double)hw[PROF_HW_INSTR] / (double)hw[PROF_HW_CYCLE],
+             (double)hw[PROF_HW_MISS] / (double)nbStep);
+  else
+    ::printf("    n/a       n/a\n");
+
+}
+
+void Kangaroo::PrintProfile(TH_PARAM *params) {
+
+  // Walkers, cycles per kangaroo step (sampled iterations only)
+  uint64_t cycles[PROF_NB_PHASE];
+  uint64_t hw[PROF_NB_HW];
+  uint64_t nbStep = 0;
+  bool hwOk = true;
+  memset(cycles,0,sizeof(cycles));
+  memset(hw,0,sizeof(hw));
+
+  ::printf("Profile: 1 iteration in %d, cycles per step\n",PROF_SAMPLE);
+  ::printf("  Thread  cyc/step");
+  for(int i = PROF_DX; i <= PROF_WAIT; i++)
+    ::printf(" %6s",CPUProfile::GetPhaseName(i));
+  ::printf("    IPC miss/step\n");
+
+  for(int t = 0; t < nbCPUThread; t++) {
+    CPUProfile *p = params[t].prof;
+    if(p == NULL) continue;
+    char name[16];
+    snprintf(name,sizeof(name),"CPU%d",t);
+    PrintProfileRow(name,p->cycles,p->hw,p->hwOk,p->nbStep,PROF_DX,PROF_WAIT);
+    for(int i = 0; i < PROF_NB_PHASE; i++) cycles[i] += p->cycles[i];
+    for(int i = 0; i < PROF_NB_HW; i++) hw[i] += p->hw[i];
+    nbStep += p->nbStep;
+    hwOk = hwOk && p->hwOk;
+  }
+  if(nbCPUThread > 1)
+    PrintProfileRow("Total",cycles,hw,hwOk,nbStep,PROF_DX,PROF_WAIT);
+
+  // Flush thread, cycles per DP
+  CPUProfile *f = clientMode ? NULL : params[nbCPUThread + nbGPUThread + 1].prof;
+  if(f && f->nbStep > 0) {
+    ::printf("  Thread    cyc/DP %6s %6s    IPC   miss/DP\n",CPUProfile::GetPhaseName(PROF_LOCK),
+             CPUProfile::GetPhaseName(PROF_TABLE));
+    PrintProfileRow("Flush",f->cycles,f->hw,f->hwOk,f->nbStep,PROF_LOCK,PROF_TABLE);
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
 string Kangaroo::GetTimeStr(double dTime) {
 
   char tmp[256];
@@ -172,13 +283,10 @@ void Kangaroo::ProcessServer() {
   t0 = Timer::get_tick();
   startTime = t0;
   double lastSave = 0;
+  uint64_t lastCount = 0;
 
-  // Acquire mutex ownership
 #ifndef WIN64
-  pthread_mutex_init(&ghMutex, NULL);
   setvbuf(stdout, NULL, _IONBF, 0);
-#else
-  ghMutex = CreateMutex(NULL,FALSE,NULL);
 #endif
 
   while(!endOfSearch) {
@@ -191,9 +299,8 @@ void Kangaroo::ProcessServer() {
     for(int i=0;i<(int)recvDP.size();i++)
       localCache.push_back(recvDP[i]);
     recvDP.clear();
-    UNLOCK(ghMutex);
 
-    // Add to hashTable
+    // Add to hashTable, ghMutex held for the flush thread of the local walkers
     for(int i = 0; i<(int)localCache.size() && !endOfSearch; i++) {
       DP_CACHE dp = localCache[i];
       for(int j = 0; j<(int)dp.nbDP && !endOfSearch; j++) {
@@ -204,6 +311,7 @@ void Kangaroo::ProcessServer() {
       }
       free(dp.dp);
     }
+    UNLOCK(ghMutex);
 
     t1 = Timer::get_tick();
 
@@ -231,8 +339,17 @@ void Kangaroo::ProcessServer() {
       double currentGap = gap128 / 1000000000.0;
       double lowest = lowestGap128 / 1000000000.0;
 
-      printf("\r[Client %d][Kang 2^%.2f][DP Count 2^%.2f/2^%.2f][Dead %.0f][T/W:%.3f][Gap:%.1f][L.Gap:%.1f][%s][%s]  ",
-        connectedClient,
+      // Local walkers (hybrid server)
+      char localInfo[64];
+      localInfo[0] = 0;
+      if(nbCPUActive > 0) {
+        uint64_t count = getCPUCount();
+        snprintf(localInfo,sizeof(localInfo),"[Local %.2f MK/s]",(double)(count - lastCount) / (t1 - t0) / 1000000.0);
+        lastCount = count;
+      }
+
+      printf("\r[Client %d]%s[Kang 2^%.2f][DP Count 2^%.2f/2^%.2f][Dead %.0f][T/W:%.3f][Gap:%.1f][L.Gap:%.1f][%s][%s]  ",
+        connectedClient,localInfo,
         log2((double)totalRW),
         log2((double)hashTable.GetNbItem()),
         log2(expectedNbOp / pow(2.0,dpSize)),
@@ -282,6 +399,11 @@ void Kangaroo::Process(TH_PARAM *params,std::string unit) {
   double keyRate = 0.0;
   double gpuKeyRate = 0.0;
 
+  // Per NUMA node CPU counters
+  uint64_t nodeCount[MAX_NODE];
+  uint64_t lastNodeCount[MAX_NODE];
+  memset(lastNodeCount,0,sizeof(lastNodeCount));
+
   memset(lastkeyRate,0,sizeof(lastkeyRate));
   memset(lastGpukeyRate,0,sizeof(lastkeyRate));
 
@@ -289,6 +411,10 @@ void Kangaroo::Process(TH_PARAM *params,std::string unit) {
   while(!hasStarted(params))
     Timer::SleepMillis(5);
 
+  // Herds are allocated and touched
+  if(keyIdx == 0)
+    HugePage::PrintCoverage("");
+
   t0 = Timer::get_tick();
   startTime = t0;
   lastGPUCount = getGPUCount();
@@ -304,6 +430,9 @@ void Kangaroo::Process(TH_PARAM *params,std::string unit) {
 
     gpuCount = getGPUCount();
     count = getCPUCount() + gpuCount;
+    memset(nodeCount,0,sizeof(nodeCount));
+    for(int i = 0; i < nbCPUThread; i++)
+      nodeCount[params[i].node] += counters[i].count;
 
     t1 = Timer::get_tick();
     keyRate = (double)(count - lastCount) / (t1 - t0);
@@ -341,29 +470,87 @@ void Kangaroo::Process(TH_PARAM *params,std::string unit) {
       double currentGap = gap128 / 1000000000.0;
       double lowest = lowestGap128 / 1000000000.0;
 
+      // CPU rate per core and gain over the scalar engine
+      char cpuInfo[256];
+      cpuInfo[0] = 0;
+      if(nbCPUActive > 0 && cpuScalarRate > 0.0) {
+        double coreRate = (avgKeyRate - avgGpuKeyRate) / (double)nbCPUActive;
+        snprintf(cpuInfo,sizeof(cpuInfo),"[CPU %.2f %s/core x%.2f]",coreRate / 1000000.0,unit.c_str(),
+                 coreRate / cpuScalarRate);
+      }
+
+      // Measured rate per NUMA node (pinned threads)
+      if(affinity && nbCPUThread > 0) {
+        string nodeInfo = "[";
+        for(int n = 0; n < nbNode && n < MAX_NODE; n++) {
+          char tmp[32];
+          snprintf(tmp,sizeof(tmp),"%sN%d %.2f",(n > 0) ? " " : "",n,
+                   (double)(nodeCount[n] - lastNodeCount[n]) / (t1 - t0) / 1000000.0);
+          nodeInfo += tmp;
+        }
+        nodeInfo += "]";
+        strncat(cpuInfo,nodeInfo.c_str(),sizeof(cpuInfo) - strlen(cpuInfo) - 1);
+      }
+
+      // Fruitless cycle escapes (symmetry)
+      if(symmetry && nbCPUThread > 0) {
+        uint64_t nbEscape = 0;
+        for(int i = 0; i < nbCPUThread; i++)
+          nbEscape += params[i].nbEscape;
+        char tmp[32];
+        snprintf(tmp,sizeof(tmp),"[Esc %.0f]",(double)nbEscape);
+        strncat(cpuInfo,tmp,sizeof(cpuInfo) - strlen(cpuInfo) - 1);
+      }
+
+      // Walk quality, stuck walks reset and DP length deviation from geometric
+      char walkInfo[64];
+      walkInfo[0] = 0;
+      if(nbCPUThread > 0) {
+        uint64_t hist[DPL_BUCKET];
+        uint64_t stuck;
+        double tv = getWalkStats(params,hist,&stuck);
+        snprintf(walkInfo,sizeof(walkInfo),"[Stuck %.0f][DPL %.1f%%]",(double)stuck,tv * 100.0);
+      }
+      if(multiKey) {
+        char tmp[32];
+        snprintf(tmp,sizeof(tmp),"[Keys %d/%d]",mkNbSolved,(int)keysToSearch.size());
+        strncat(walkInfo,tmp,sizeof(walkInfo) - strlen(walkInfo) - 1);
+      }
+
       if(clientMode) {
-        printf("\r[%.2f %s][GPU %.2f %s][Count 2^%.2f][T/W:%.3f][Gap:%.1f][L.Gap:%.1f][%s][Server %6s]  ",
+        printf("\r[%.2f %s][GPU %.2f %s]%s[Count 2^%.2f][T/W:%.3f]%s[Gap:%.1f][L.Gap:%.1f][%s][Server %6s]  ",
           avgKeyRate / 1000000.0,unit.c_str(),
           avgGpuKeyRate / 1000000.0,unit.c_str(),
+          cpuInfo,
           log2((double)count + offsetCount),
-          twRatio,
+          twRatio,walkInfo,
           currentGap, lowest,
           GetTimeStr(t1 - startTime + offsetTime).c_str(),
           serverStatus.c_str()
           );
       } else {
-        printf("\r[%.2f %s][GPU %.2f %s][Count 2^%.2f][Dead %.0f][T/W:%.3f][Gap:%.1f][L.Gap:%.1f][%s (Avg %s)][%s]  ",
+        printf("\r[%.2f %s][GPU %.2f %s]%s[Count 2^%.2f][Dead %.0f][T/W:%.3f]%s[Gap:%.1f][L.Gap:%.1f][%s (Avg %s)][%s]  ",
           avgKeyRate / 1000000.0,unit.c_str(),
           avgGpuKeyRate / 1000000.0,unit.c_str(),
+          cpuInfo,
           log2((double)count + offsetCount),
           (double)collisionInSameHerd,
-          twRatio,
+          twRatio,walkInfo,
           currentGap, lowest,
           GetTimeStr(t1 - startTime + offsetTime).c_str(),GetTimeStr(expectedTime).c_str(),
           hashTable.GetSizeInfo().c_str()
         );
       }
 
+      if(profile) {
+        ::printf("\n");
+        PrintProfile(params);
+      }
+
+      // Elastic scaling
+      if(ctlFile.length() > 0)
+        ScaleCPU(params);
+
     }
 
     // Save request
@@ -382,8 +569,12 @@ void Kangaroo::Process(TH_PARAM *params,std::string unit) {
     if(!clientMode && maxStep>0.0) {
       double max = expectedNbOp * maxStep; 
       if( (double)count > max ) {
-        ::printf("\nKey#%2d [XX]Pub:  0x%s \n",keyIdx,secp->GetPublicKeyHex(true,keysToSearch[keyIdx]).c_str());
-        ::printf("       Aborted !\n");
+        for(int k = 0; k < (int)keysToSearch.size(); k++) {
+          if(multiKey ? (bool)mkSolved[k] : k != (int)keyIdx)
+            continue;
+          ::printf("\nKey#%2d [XX]Pub:  0x%s \n",k,secp->GetPublicKeyHex(true,keysToSearch[k]).c_str());
+          ::printf("       Aborted !\n");
+        }
         endOfSearch = true;
         Timer::SleepMillis(1000);
       }
@@ -391,6 +582,7 @@ void Kangaroo::Process(TH_PARAM *params,std::string unit) {
 
     lastCount = count;
     lastGPUCount = gpuCount;
+    memcpy(lastNodeCount,nodeCount,sizeof(nodeCount));
     t0 = t1;
 
   }
@@ -565,3 +757,80 @@ void Kangaroo::ScanGapsThread(TH_PARAM *p) {
 
 }
 
+// ----------------------------------------------------------------------------
+
+void Kangaroo::PushDP(TH_PARAM *ph,std::vector<ITEM> &dp) {
+
+  // Lock free, wait for the flush thread when the queue is full
+  for(int i = 0; i < (int)dp.size() && !endOfSearch; i++) {
+    while(!ph->dpQueue->Push(dp[i]) && !endOfSearch)
+      Timer::SleepMillis(1);
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
+uint32_t Kangaroo::FlushDP() {
+
+  // Move staged DP to the hash table, must be called with ghMutex locked
+  // (ghMutex serializes the consumer side of the DP queues)
+  uint32_t nbDP = 0;
+  ITEM it;
+
+  for(int i = 0; i < nbCPUThread + nbGPUThread; i++) {
+
+    TH_PARAM *p = walkers + i;
+    if(p->dpQueue == NULL)
+      continue;
+
+    while(!endOfSearch && p->dpQueue->Pop(&it)) {
+
+      uint32_t kType = GetKType(p->threadId,it.kIdx);
+      if(!AddToTable(&it.x,&it.d,kType)) {
+        // Collision inside the same herd, the walker resets the kangaroo.
+        // If its queue is full, the kangaroo will be caught at its next DP.
+        // Gaudry-Schost walks are already restarted at their DP.
+        if(!gaudrySchost)
+          p->deadQueue->Push(it.kIdx);
+        collisionInSameHerd++;
+      }
+      nbDP++;
+
+      // Tame DP database complete
+      if(tameDBBuild > 0 && tameCount >= tameDBBuild)
+        endOfSearch = true;
+
+    }
+
+  }
+
+  return nbDP;
+
+}
+
+// ----------------------------------------------------------------------------
+
+void Kangaroo::FlushDPThread(TH_PARAM *p) {
+
+  // Single consumer of the walker DP queues, one table lock per batch
+  CPUProfile *prof = p->prof;
+  if(prof) prof->Open();
+
+  while(!endOfSearch) {
+
+    if(prof) prof->StartSample();
+    uint64_t pTick = prof ? prof->Begin() : 0;
+    LOCK(ghMutex);
+    if(pTick) prof->Mark(PROF_LOCK,&pTick);
+    uint32_t nbDP = FlushDP();
+    if(pTick) prof->Mark(PROF_TABLE,&pTick);
+    UNLOCK(ghMutex);
+    if(prof) prof->EndSample(nbDP);
+
+    if(nbDP == 0)
+      Timer::SleepMillis(2);
+
+  }
+
+}
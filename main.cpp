@@ -68,6 +68,24 @@ void printUsage() {
   printf(" -g g1x,g1y,g2x,g2y,...: Specify GPU(s) kernel gridsize, default is 2*(MP),2*(Core/MP)\n");
   printf(" -d: Specify number of leading zeros for the DP method (default is auto)\n");
   printf(" -t nbThread: Secify number of thread\n");
+  printf(" -engine name: CPU walk engine, auto (default), scalar or ifma\n");
+  printf(" -affinity: Pin CPU threads to cores, herds allocated on the local NUMA node\n");
+  printf(" -sym: Use symmetry (negation map), taken from the work file or the server if any\n");
+  printf(" -fastseed: Derive the herds from random base points by chains of small random steps (faster startup)\n");
+  printf(" -ctl file: Control file holding the wanted number of CPU threads, re-read at each status (up to the core count)\n");
+  printf(" -multikey: Search all the keys of the input file at once, one tame herd for all of them (CPU only)\n");
+  printf(" -method n: Number of herds, 2 (tame/wild, default) or 4 (2 tame, wild from key and -key, CPU only)\n");
+  printf(" -bsgs: Baby-step giant-step solver (CPU only, ranges up to 2^64), default is automatic for small ranges\n");
+  printf(" -nobsgs: Never select the baby-step giant-step solver\n");
+  printf(" -gs: Gaudry-Schost solver, walks restarted at a random point after each DP (CPU only)\n");
+  printf(" -tdb file: Precomputed tame DP database, the search runs only wild kangaroos against it (CPU only)\n");
+  printf(" -tdbbuild nbDP: Walk tame kangaroos only and write nbDP tame DP to the -tdb database\n");
+  printf(" -autotune: Benchmark group size and thread count (up to -t), choose DP for the RAM budget, cached per host\n");
+  printf(" -ram MB: RAM budget of the hash table for -autotune (default is half of the physical memory)\n");
+  printf(" -nohugepage: Do not back herds and hash table with huge pages\n");
+  printf(" -profile: Print a per phase cycle breakdown of the walk (and hardware counters if allowed) at each status and at exit\n");
+  printf(" -gtable bits: Fixed base table with bits wide windows (9..18) for the scalar multiplications\n");
+  printf(" -gtablefile file: Cache file of the -gtable table (default is ~/.kangaroo256.gtable<bits>)\n");
   printf(" -w workfile: Specify file to save work into (current processed key only)\n");
   printf(" -wtxt workfile: Specify file to save work into (text format)\n");
   printf(" -i workfile: Specify file to load work from (current processed key only)\n");
@@ -83,7 +101,7 @@ void printUsage() {
   printf(" -wpartcreate name: Create empty partitioned work file (name is a directory)\n");
   printf(" -wcheck worfile: Check workfile integrity\n");
   printf(" -m maxStep: number of operations before give up the search (maxStep*expected operation)\n");
-  printf(" -s: Start in server mode\n");
+  printf(" -s: Start in server mode, with -t the server also walks kangaroos locally\n");
   printf(" -c server_ip: Start in client mode and connect to server server_ip\n");
   printf(" -sp port: Server port, default is 17403\n");
   printf(" -nt timeout: Network timeout in millisec (default is 3000ms)\n");
@@ -196,6 +214,23 @@ static bool serverMode = false;
 static string serverIP = "";
 static string outputFile = "";
 static bool splitWorkFile = false;
+static int cpuEngine = CPU_ENGINE_AUTO;
+static bool affinity = false;
+static bool symmetry = false;
+static bool autoTune = false;
+static bool fastSeed = false;
+static bool profile = false;
+static bool threadSet = false;
+static string ctlFile = "";
+static bool multiKey = false;
+static string tameDBFile = "";
+static uint64_t tameDBBuild = 0;
+static int method = 2;
+static bool gaudrySchost = false;
+static int bsgsMode = BSGS_AUTO;
+static double ramBudget = 0.0;
+static int gTableBit = 0;
+static string gTableFile = "";
 
 static string cli_start_dec;
 static string cli_end_dec;
@@ -209,7 +244,7 @@ static bool cli_cleanup_registered = false;
 int main(int argc, char* argv[]) {
 
 #ifdef USE_SYMMETRY
-  printf("Kangaroo v" RELEASE " (with symmetry [256 range edition by NotATether])\n");
+  printf("Kangaroo v" RELEASE " (GPU kernel with symmetry [256 range edition by NotATether])\n");
 #else
   printf("Kangaroo v" RELEASE " [256 range edition by NotATether]\n");
 #endif
@@ -230,6 +265,82 @@ int main(int argc, char* argv[]) {
     if(strcmp(argv[a], "-t") == 0) {
       CHECKARG("-t",1);
       nbCPUThread = getInt("nbCPUThread",argv[a]);
+      threadSet = true;
+      a++;
+    } else if(strcmp(argv[a],"-engine") == 0) {
+      CHECKARG("-engine",1);
+      if(strcmp(argv[a],"auto") == 0) {
+        cpuEngine = CPU_ENGINE_AUTO;
+      } else if(strcmp(argv[a],"scalar") == 0) {
+        cpuEngine = CPU_ENGINE_SCALAR;
+      } else if(strcmp(argv[a],"ifma") == 0) {
+        cpuEngine = CPU_ENGINE_IFMA;
+        if(!CPUEngine::IsSupported(cpuEngine)) {
+          printf("Warning, %s engine not supported on this CPU, using scalar\n",CPUEngine::GetName(cpuEngine));
+          cpuEngine = CPU_ENGINE_SCALAR;
+        }
+      } else {
+        printf("Invalid engine argument, auto, scalar or ifma expected\n");
+        exit(-1);
+      }
+      a++;
+    } else if(strcmp(argv[a],"-affinity") == 0) {
+      a++;
+      affinity = true;
+    } else if(strcmp(argv[a],"-sym") == 0) {
+      a++;
+      symmetry = true;
+    } else if(strcmp(argv[a],"-fastseed") == 0) {
+      a++;
+      fastSeed = true;
+    } else if(strcmp(argv[a],"-autotune") == 0) {
+      a++;
+      autoTune = true;
+    } else if(strcmp(argv[a],"-ram") == 0) {
+      CHECKARG("-ram",1);
+      ramBudget = getDouble("ramBudget",argv[a]);
+      a++;
+    } else if(strcmp(argv[a],"-ctl") == 0) {
+      CHECKARG("-ctl",1);
+      ctlFile = string(argv[a]);
+      a++;
+    } else if(strcmp(argv[a],"-profile") == 0) {
+      a++;
+      profile = true;
+    } else if(strcmp(argv[a],"-multikey") == 0) {
+      a++;
+      multiKey = true;
+    } else if(strcmp(argv[a],"-bsgs") == 0) {
+      bsgsMode = BSGS_ON;
+      a++;
+    } else if(strcmp(argv[a],"-nobsgs") == 0) {
+      bsgsMode = BSGS_OFF;
+      a++;
+    } else if(strcmp(argv[a],"-gs") == 0) {
+      gaudrySchost = true;
+      a++;
+    } else if(strcmp(argv[a],"-method") == 0) {
+      CHECKARG("-method",1);
+      method = getInt("method",argv[a]);
+      a++;
+    } else if(strcmp(argv[a],"-tdb") == 0) {
+      CHECKARG("-tdb",1);
+      tameDBFile = string(argv[a]);
+      a++;
+    } else if(strcmp(argv[a],"-tdbbuild") == 0) {
+      CHECKARG("-tdbbuild",1);
+      tameDBBuild = (uint64_t)getDouble("nbDP",argv[a]);
+      a++;
+    } else if(strcmp(argv[a],"-nohugepage") == 0) {
+      a++;
+      HugePage::SetEnabled(false);
+    } else if(strcmp(argv[a],"-gtable") == 0) {
+      CHECKARG("-gtable",1);
+      gTableBit = getInt("gTableBit",argv[a]);
+      a++;
+    } else if(strcmp(argv[a],"-gtablefile") == 0) {
+      CHECKARG("-gtablefile",1);
+      gTableFile = string(argv[a]);
       a++;
     } else if(strcmp(argv[a],"-d") == 0) {
       CHECKARG("-d",1);
@@ -391,6 +502,22 @@ int main(int argc, char* argv[]) {
 
   }
 
+  // Wide window fixed base table, cached in the home directory by default
+  if(gTableBit > 0) {
+    if(gTableFile.length() == 0) {
+#ifdef WIN64
+      const char *home = getenv("USERPROFILE");
+#else
+      const char *home = getenv("HOME");
+#endif
+      gTableFile = ".kangaroo256.gtable" + std::to_string(gTableBit);
+      if(home != NULL && home[0] != 0)
+        gTableFile = string(home) + "/" + gTableFile;
+    }
+    if(!secp->InitTable(gTableBit,gTableFile))
+      exit(-1);
+  }
+
   bool using_cli_config = false;
   if(!cli_start_dec.empty() || !cli_end_dec.empty() ||
      !cli_start_hex.empty() || !cli_end_hex.empty() ||
@@ -493,13 +620,34 @@ int main(int argc, char* argv[]) {
     exit(-1);
   }
 
+  if(method != 2 && method != 4) {
+    printf("-method must be 2 or 4\n");
+    exit(-1);
+  }
+  if(method == 4 && (symmetry || multiKey || !tameDBFile.empty() || serverMode || !serverIP.empty())) {
+    printf("-method 4 cannot be used with -sym, -multikey, -tdb or client/server mode\n");
+    exit(-1);
+  }
+
+  if(gaudrySchost && (method == 4 || !tameDBFile.empty())) {
+    printf("-gs cannot be used with -method 4 or -tdb\n");
+    exit(-1);
+  }
+
+  if(tameDBBuild > 0 && tameDBFile.empty()) {
+    printf("-tdbbuild requires -tdb\n");
+    exit(-1);
+  }
+
   if(saveKangarooText && workTextFile.empty()) {
     printf("-wstxt requires -wtxt\n");
     exit(-1);
   }
 
   Kangaroo *v = new Kangaroo(secp,dp,gpuEnable,workFile,iWorkFile,savePeriod,saveKangaroo,saveKangarooByServer,
-                             maxStep,wtimeout,port,ntimeout,serverIP,outputFile,splitWorkFile,workTextFile,saveKangarooText);
+                             maxStep,wtimeout,port,ntimeout,serverIP,outputFile,splitWorkFile,workTextFile,saveKangarooText,
+                             cpuEngine,affinity,symmetry,autoTune,ramBudget,fastSeed,profile,ctlFile,multiKey,
+                             tameDBFile,tameDBBuild,method,gaudrySchost,bsgsMode);
   if(checkFlag) {
     v->Check(gpuId,gridSize);  
     exit(0);
@@ -529,7 +677,7 @@ int main(int argc, char* argv[]) {
       }
     }
     if(serverMode)
-      v->RunServer();
+      v->RunServer(threadSet ? nbCPUThread : 0);
     else
       v->Run(nbCPUThread,gpuId,gridSize);
   }